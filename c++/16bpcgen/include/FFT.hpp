@@ -0,0 +1,32 @@
+#ifndef BPCGEN_FFT_HPP_
+#define BPCGEN_FFT_HPP_
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+/**
+ * 長さ size (2 のべき乗) の複素数列の基数 2 の高速フーリエ変換。
+ * 回転因子とビット反転の並びは構築時に作るので、同じ長さの変換を何度でも繰り返せる。
+ * 逆変換は正規化しない(順変換と逆変換を続けると size 倍になる)。
+ */
+class FFT{
+public:
+	typedef std::complex<double> complex_type;
+	explicit FFT(std::size_t size);
+	~FFT();
+	std::size_t size()const{return size_;}
+	void transform(complex_type* data, bool inverse = false)const;
+	/**
+	 * size x size の行優先の 2 次元配列を変換する。列は work に何列かずつ写して変換するので、
+	 * work の大きさはこの関数が決める。
+	 */
+	void transform2d(complex_type* data, std::vector<complex_type>& work, bool inverse = false)const;
+private:
+	std::size_t size_;
+	std::vector<std::size_t> reversal_;
+	std::vector<complex_type> forward_;
+	std::vector<complex_type> inverse_;
+};
+
+#endif
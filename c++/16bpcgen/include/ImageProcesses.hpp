@@ -1,9 +1,14 @@
 #ifndef BPCGEN_IMAGEPROCESSES_HPP_
 #define BPCGEN_IMAGEPROCESSES_HPP_
 
+#include <string>
+#include <utility>
 #include <vector>
 #include "ImageProcess.hpp"
+#include "Pixel.hpp"
 class PixelConverter;
+class Primaries;
+class TransferFunction;
 
 class Area{
 public:
@@ -15,6 +20,31 @@ public:
 	const row_t offset_y_;
 };
 
+/**
+ * 処理範囲を行ごとの区間 [first, last) の列として持つ。矩形や 1bit マスクを何度でも足せて、
+ * 重なったり接したりする区間は足すたびに併合されるので、各画素は高々 1 回しか含まれない。
+ */
+class Region{
+public:
+	typedef std::pair<column_t, column_t> Span;
+	typedef std::vector<Span> Spans;
+	Region(column_t width, row_t height);
+	~Region();
+	Region& add(const Area& area);
+	/**
+	 * mask は width * height 要素の行優先の配列で、真の画素を範囲に加える。
+	 */
+	Region& add(const std::vector<bool>& mask);
+	column_t width()const{return width_;}
+	row_t height()const{return height_;}
+	const Spans& spans(row_t h)const{return rows_[h];}
+private:
+	void insert(row_t h, column_t first, column_t last);
+	column_t width_;
+	row_t height_;
+	std::vector<Spans> rows_;
+};
+
 class AreaSpecifier: public ImageProcess{
 public:
 	AreaSpecifier(const Area& area = Area()): area_(area){}
@@ -33,16 +63,42 @@ private:
 	const PixelConverter& converter_;
 };
 
+/**
+ * Region の全ての区間に converter を 1 パスで適用する。
+ *   Region zones(image.width(), image.height());
+ *   zones.add(Area(64, 64, 0, 0)).add(Area(64, 64, 128, 0));
+ *   image >>= RegionTone(Offset(0x100), zones);
+ */
+class RegionTone: public ImageProcess{
+public:
+	RegionTone(const PixelConverter& converter, const Region& region):
+		converter_(converter), region_(region){}
+	virtual Image& process(Image& image)const;
+private:
+	const PixelConverter& converter_;
+	const Region& region_;
+};
+
 class Normalize: public AreaSpecifier{
 public:
 	Normalize(const Area& area = Area()): AreaSpecifier(area){}
 	virtual Image& process(Image& image)const;
 };
 
+/**
+ * (2 * radius + 1) 四方の窓のメディアン。窓は画像の端で切り詰める。
+ * radius が 1, 2 なら内側の画素はソーティングネットワーク、それ以外は Perreault-Hebert の
+ * 列ヒストグラムで求めるので、画素あたりの手間は radius にほぼよらない。radius は 127 まで。
+ */
 class Median: public AreaSpecifier{
 public:
-	Median(const Area& area = Area()): AreaSpecifier(area){}
+	Median(const Area& area = Area()): AreaSpecifier(area), radius_(1){}
+	Median(unsigned int radius, const Area& area = Area()): AreaSpecifier(area), radius_(radius){}
 	virtual Image& process(Image& image)const;
+private:
+	Image& network(Image& image, const Image& source, column_t limit_w, row_t limit_h)const;
+	Image& histogram(Image& image, const Image& source, column_t limit_w, row_t limit_h)const;
+	const unsigned int radius_;
 };
 
 class Crop: public AreaSpecifier{
@@ -51,74 +107,399 @@ public:
 	virtual Image& process(Image& image)const;
 };
 
+/**
+ * kernel が列ベクトルと行ベクトルの積(階数 1)に分解できるときは、構築時にそれを見つけて
+ * 横方向と縦方向の 1 次元畳み込みに分けて処理するので、画素あたりの積和が K * K から 2K になる。
+ * 分解できない 15x15 以上のカーネルは FFT によるタイルごとの畳み込み(overlap-save)で処理する。
+ * 画像の外側の画素は border で補う。
+ */
 class Filter: public ImageProcess{
 public:
 	typedef std::vector<double> KernelRow;
 	typedef std::vector<KernelRow> Kernel;
-	Filter(const Kernel& kernel): kernel_(kernel){}
+	/**
+	 * BORDER_CONSTANT は constant で埋め、BORDER_CLAMP は端の画素を延ばし、
+	 * BORDER_MIRROR は端の画素を軸に折り返し(... 2 1 | 0 1 2 ...)、BORDER_WRAP は反対側から回り込ませる。
+	 */
+	enum Border{
+		BORDER_CONSTANT,
+		BORDER_CLAMP,
+		BORDER_MIRROR,
+		BORDER_WRAP
+	};
+	Filter(const Kernel& kernel, Border border = BORDER_CONSTANT, const Pixel<>& constant = black);
+	virtual ~Filter();
 	virtual Image& process(Image& image)const;
+	bool separable()const{return !row_.empty() || !row_weights_.empty();}
+protected:
+	Filter(const KernelRow& row, const KernelRow& column, Border border, const Pixel<>& constant);
 private:
+	void rationalize();
+	Image& process_separable(Image& image)const;
+	Image& process_fft(Image& image)const;
 	Kernel kernel_;
+	KernelRow row_;
+	KernelRow column_;
+	std::vector<int> weights_;
+	std::vector<int> row_weights_;
+	std::vector<int> column_weights_;
+	int divisor_;
+	Border border_;
+	Pixel<> constant_;
+};
+
+/**
+ * 横方向のカーネル row と縦方向のカーネル column を続けて掛ける。
+ * Filter に column[i] * row[j] を要素とするカーネルを渡したのと同じ結果になる。
+ */
+class SeparableFilter: public Filter{
+public:
+	SeparableFilter(const KernelRow& row, const KernelRow& column, Border border = BORDER_CONSTANT, const Pixel<>& constant = black):
+		Filter(row, column, border, constant){}
 };
 
 class WeightedSmoothing: public Filter{
 public:
-	WeightedSmoothing(): Filter(init()){}
+	explicit WeightedSmoothing(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
 class UnSharpMask: public Filter{
 public:
-	UnSharpMask(): Filter(init()){}
+	explicit UnSharpMask(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
 class Prewitt: public Filter{
 public:
-	Prewitt(): Filter(init()){}
+	explicit Prewitt(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
 class Sobel: public Filter{
 public:
-	Sobel(): Filter(init()){}
+	explicit Sobel(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
 class Laplacian3x3: public Filter{
 public:
-	Laplacian3x3(): Filter(init()){}
+	explicit Laplacian3x3(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
 class Laplacian5x5: public Filter{
 public:
-	Laplacian5x5(): Filter(init()){}
+	explicit Laplacian5x5(Border border = BORDER_CONSTANT): Filter(init(), border){}
 private:
 	static Kernel init();
 };
 
-class HScale: public ImageProcess{
+/**
+ * Sobel か Prewitt の横と縦の微分を 1 パスで求め、チャンネルごとの勾配の大きさを出力する。大きさは微分を
+ * カーネルの正の重みの和(Sobel は 4、Prewitt は 3)で割ったもの。NORM_APPROXIMATE は
+ * max(|gx|, |gy|) + 3/8 * min(|gx|, |gy|) で、NORM_L2 との差は 7% 以内。画像の外は border で補う。
+ * orientation を渡すと、大きさが最大のチャンネルの勾配の向きを 0 (横)、1 (gx と gy が同符号の斜め)、2 (縦)、
+ * 3 (gx と gy が異符号の斜め)に量子化して、画素ごとに行優先で書く。
+ */
+class Gradient: public ImageProcess{
 public:
-	HScale(column_t width): width_(width){}
+	enum Operator{
+		OPERATOR_SOBEL,
+		OPERATOR_PREWITT
+	};
+	enum Norm{
+		NORM_L1,
+		NORM_L2,
+		NORM_APPROXIMATE
+	};
+	Gradient(Operator op = OPERATOR_SOBEL, Norm norm = NORM_L2, std::vector<uint8_t>* orientation = 0, Filter::Border border = Filter::BORDER_CLAMP):
+		operator_(op), norm_(norm), orientation_(orientation), border_(border){}
+	Gradient(const Gradient& gradient):
+		ImageProcess(gradient), operator_(gradient.operator_), norm_(gradient.norm_), orientation_(gradient.orientation_), border_(gradient.border_){}
+	Gradient& operator=(const Gradient& gradient);
 	virtual Image& process(Image& image)const;
 private:
+	Operator operator_;
+	Norm norm_;
+	std::vector<uint8_t>* orientation_;
+	Filter::Border border_;
+};
+
+/**
+ * Young-van Vliet の 3 次の再帰フィルタを縦横に前後 2 回ずつ掛けたガウスぼかし。画素あたりの手間は
+ * sigma によらない。画像の外は端の画素を延ばしたものとして扱い(Triggs-Sdika の境界条件)、
+ * sigma は 0.5 以上。
+ */
+class GaussianBlur: public ImageProcess{
+public:
+	GaussianBlur(double sigma);
+	virtual Image& process(Image& image)const;
+private:
+	double sigma_;
+	double b_;
+	double a_[3];
+	double m_[3][3];
+};
+
+/**
+ * width x height の窓の平均(width, height は奇数)。縦と横の移動和を整数で更新するので、
+ * 画素あたりの手間は窓の大きさによらない。画像の外は border で補う。
+ */
+class BoxBlur: public ImageProcess{
+public:
+	BoxBlur(column_t width, row_t height, Filter::Border border = Filter::BORDER_CLAMP, const Pixel<>& constant = black);
+	virtual Image& process(Image& image)const;
+private:
+	column_t width_;
+	row_t height_;
+	Filter::Border border_;
+	Pixel<> constant_;
+};
+
+/**
+ * width x height の矩形の構造要素による濃淡のモルフォロジー。縦横それぞれの 1 次元の最小(最大)を
+ * van Herk/Gil-Werman の方法で求めるので、画素あたりの比較は窓の大きさによらず 1 方向に 3 回ほど。
+ * 窓の基準点は左上から (width/2, height/2) で、画像の外は結果に影響しない値とみなす。
+ */
+class Morphology: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const = 0;
+protected:
+	Morphology(column_t width, row_t height);
+	Image& erode(Image& image)const;
+	Image& dilate(Image& image)const;
 	column_t width_;
+	row_t height_;
+};
+
+class Erode: public Morphology{
+public:
+	Erode(column_t width, row_t height): Morphology(width, height){}
+	virtual Image& process(Image& image)const;
+};
+
+class Dilate: public Morphology{
+public:
+	Dilate(column_t width, row_t height): Morphology(width, height){}
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 収縮してから膨張する。
+ */
+class Open: public Morphology{
+public:
+	Open(column_t width, row_t height): Morphology(width, height){}
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 膨張してから収縮する。
+ */
+class Close: public Morphology{
+public:
+	Close(column_t width, row_t height): Morphology(width, height){}
+	virtual Image& process(Image& image)const;
 };
 
-class VScale: public ImageProcess{
+/**
+ * 画像から Open したものを引く(構造要素より小さな明るい部分だけが残る)。
+ */
+class TopHat: public Morphology{
 public:
-	VScale(row_t height): height_(height){}
+	TopHat(column_t width, row_t height): Morphology(width, height){}
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 空間は sigma_s 画素ごと、値は sigma_r ごとに間引いた 3 次元の格子(bilateral grid)による近似のバイラテラルフィルタ。
+ * 画素を最も近い格子点に足し込み(splat)、格子を 3 方向に [1 4 6 4 1]/16 でぼかし、画素の位置と値で格子を
+ * 3 線形補間して重みで割る(slice)。値の軸はチャンネルごとに独立で、画像の最小値から最大値までを覆う。
+ * 手間は画素数と格子点の数に比例し、格子は sigma_s が大きいほど小さくなる。sigma_s と sigma_r は 1 以上。
+ */
+class Bilateral: public ImageProcess{
+public:
+	Bilateral(double sigma_s, double sigma_r);
 	virtual Image& process(Image& image)const;
 private:
+	double sigma_s_;
+	double sigma_r_;
+};
+
+/**
+ * 拡大縮小の共通部分。INTERPOLATION_NEAREST 以外は出力画素ごとの係数表を作って 14bit の固定小数点で畳み込み、
+ * 縮小するときはカーネルを縮小率に合わせて広げるので折り返し雑音が出ない。画像の外は端の画素を延ばす。
+ */
+class Scale: public ImageProcess{
+public:
+	enum Interpolation{
+		INTERPOLATION_NEAREST,
+		INTERPOLATION_BOX,
+		INTERPOLATION_BILINEAR,
+		INTERPOLATION_BICUBIC,
+		INTERPOLATION_LANCZOS3
+	};
+	virtual Image& process(Image& image)const = 0;
+protected:
+	Scale(Interpolation interpolation): interpolation_(interpolation){}
+	Interpolation interpolation_;
+};
+
+class HScale: public Scale{
+public:
+	HScale(column_t width, Interpolation interpolation = INTERPOLATION_BICUBIC): Scale(interpolation), width_(width){}
+	virtual Image& process(Image& image)const;
+private:
+	column_t width_;
+};
+
+class VScale: public Scale{
+public:
+	VScale(row_t height, Interpolation interpolation = INTERPOLATION_BICUBIC): Scale(interpolation), height_(height){}
+	virtual Image& process(Image& image)const;
+private:
+	row_t height_;
+};
+
+/**
+ * HScale と VScale を続けたのと同じ結果を、横に拡大縮小した行を縦のタップ数分だけ輪状に持って 1 パスで作る。
+ * 中間の画像を作らないので、入力を 1 回読んで出力を 1 回書くだけで済む。
+ */
+class Resize: public Scale{
+public:
+	/**
+	 * stream() で出力行を上から順に受け取る。
+	 */
+	class Sink{
+	public:
+		virtual ~Sink(){}
+		virtual void write(row_t h, const Row& row) = 0;
+	};
+	Resize(column_t width, row_t height, Interpolation interpolation = INTERPOLATION_BICUBIC):
+		Scale(interpolation), width_(width), height_(height){}
+	virtual Image& process(Image& image)const;
+	/**
+	 * 出力画像を作らずに 1 行ずつ sink に渡す。行の順を守るため 1 スレッドで処理する。
+	 */
+	void stream(const Image& image, Sink& sink)const;
+private:
+	column_t width_;
+	row_t height_;
+};
+
+/**
+ * 射影変換。座標は画素 (w, h) の中心を (w + 0.5, h + 0.5) とする連続座標で、出力の各画素の中心を逆に写した
+ * 入力の位置を interpolation (最近傍、双線形、双 3 次のいずれか)で標本化する。入力の外は background とする。
+ * 出力はタイルに分けてスレッドに割り振り、タイルの行の中では同次座標を足し算だけで進める。
+ */
+class Warp: public ImageProcess{
+public:
+	typedef double Matrix[3][3];
+	/**
+	 * matrix は入力の同次座標 (x, y, 1) を出力の同次座標に写す。出力の大きさは入力と同じ。
+	 */
+	Warp(const Matrix& matrix, Scale::Interpolation interpolation = Scale::INTERPOLATION_BILINEAR, const Pixel<>& background = black);
+	virtual Image& process(Image& image)const;
+	/**
+	 * 4 点 source[i] をそれぞれ destination[i] に写す射影変換を求める。
+	 */
+	static void homography(const double (*source)[2], const double (*destination)[2], Matrix& m);
+private:
+	Matrix inverse_;
+	Scale::Interpolation interpolation_;
+	Pixel<> background_;
+};
+
+/**
+ * 同じ幾何補正を何枚もの画像に掛けるための座標表。出力の画素ごとに、双線形で標本化する入力の 2x2 画素の左上の位置と
+ * 横と縦の 1/256 単位の端数を 8 バイトで持つので、構築した後の process() は表を引いて 4 画素を混ぜるだけになる。
+ * 入力の外に半画素より大きくはみ出す位置は background とし、それより内側は端の画素を延ばす。
+ * 表は write() でファイルに書き、ファイル名を取るコンストラクタで読み戻せる。
+ */
+class RemapTable: public ImageProcess{
+public:
+	/**
+	 * 出力の連続座標 (x, y) を入力の連続座標 (u, v) に写す関数。座標は Warp と同じく画素 (w, h) の中心が (w + 0.5, h + 0.5)。
+	 */
+	class Mapping{
+	public:
+		virtual ~Mapping(){}
+		virtual void map(double x, double y, double& u, double& v)const = 0;
+	};
+	/**
+	 * Warp と同じく入力を出力に写す matrix の逆写像。
+	 */
+	class Projective: public Mapping{
+	public:
+		Projective(const Warp::Matrix& matrix);
+		virtual void map(double x, double y, double& u, double& v)const;
+	private:
+		Warp::Matrix inverse_;
+	};
+	/**
+	 * 中心 (center_x, center_y) から radius を 1 とした距離 r の点を、中心から 1 + k1 r^2 + k2 r^4 + k3 r^6 倍の位置から取る。
+	 */
+	class Radial: public Mapping{
+	public:
+		Radial(double center_x, double center_y, double radius, double k1, double k2 = 0.0, double k3 = 0.0):
+			center_x_(center_x), center_y_(center_y), radius_(radius), k1_(k1), k2_(k2), k3_(k3){}
+		virtual void map(double x, double y, double& u, double& v)const;
+	private:
+		double center_x_;
+		double center_y_;
+		double radius_;
+		double k1_;
+		double k2_;
+		double k3_;
+	};
+	/**
+	 * 出力の width x height を columns x rows 個の格子点で等分し、格子点ごとに入力の位置を与えて間を双線形に補う。
+	 * points は行優先に並べた格子点の (u, v) の組で、columns * rows * 2 要素。
+	 */
+	class Mesh: public Mapping{
+	public:
+		Mesh(double width, double height, column_t columns, row_t rows, const std::vector<double>& points);
+		virtual ~Mesh();
+		virtual void map(double x, double y, double& u, double& v)const;
+	private:
+		double width_;
+		double height_;
+		column_t columns_;
+		row_t rows_;
+		std::vector<double> points_;
+	};
+	/**
+	 * width x height (それぞれ 2 以上)の画像に mapping を掛ける表を作る。
+	 */
+	RemapTable(column_t width, row_t height, const Mapping& mapping, const Pixel<>& background = black);
+	explicit RemapTable(const std::string& filename);
+	virtual ~RemapTable();
+	virtual Image& process(Image& image)const;
+	void write(const std::string& filename)const;
+	column_t width()const{return width_;}
+	row_t height()const{return height_;}
+private:
+	struct Entry{
+		uint32_t offset;
+		uint16_t fraction_x;
+		uint16_t fraction_y;
+	};
+	column_t width_;
 	row_t height_;
+	Pixel<> background_;
+	std::vector<Entry> entries_;
 };
 
+/**
+ * vertex の角を (width_offset, height_offset) だけ内側に寄せ、他の 3 つの角はそのままにする台形補正。
+ * 画像の大きさから射影変換を作って Warp で処理する。
+ */
 class KeyStone: public ImageProcess{
 public:
 	enum Vertex{
@@ -127,13 +508,101 @@ public:
 		BOTTOM_LEFT,
 		BOTTOM_RIGHT
 	};
-	KeyStone(Vertex vertex, column_t width_offset, row_t height_offset):
-		vertex_(vertex), width_offset_(width_offset), height_offset_(height_offset){}
+	KeyStone(Vertex vertex, column_t width_offset, row_t height_offset, Scale::Interpolation interpolation = Scale::INTERPOLATION_BILINEAR):
+		vertex_(vertex), width_offset_(width_offset), height_offset_(height_offset), interpolation_(interpolation){}
 	virtual Image& process(Image& image)const;
 private:
 	Vertex vertex_;
 	column_t width_offset_;
 	row_t height_offset_;
+	Scale::Interpolation interpolation_;
+};
+
+/**
+ * 向きを変える処理。行と列が入れ替わるものは出力をタイルに分けてスレッドに割り振り、タイルの中は長い辺を半分に割る
+ * 再帰で L1 に収まる大きさまで分けてから写すので、キャッシュの大きさによらず入力も出力もブロック単位で読み書きする。
+ * 正方形の画像と、行と列が入れ替わらない処理は画像の中で入れ替える。
+ */
+class Transpose: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 時計回りに 90 度回す。
+ */
+class Rotate90: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+class Rotate180: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 反時計回りに 90 度回す。
+ */
+class Rotate270: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 左右を反転する。
+ */
+class FlipH: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 上下を反転する。
+ */
+class FlipV: public ImageProcess{
+public:
+	virtual Image& process(Image& image)const;
+};
+
+/**
+ * 線形光で原色を変換する(白色点が異なれば Bradford 変換で順応させる)。
+ * compression が真なら、変換先で負になる彩度の高い色を無彩色からの距離で
+ * 閾値より外側だけ滑らかに圧縮し、変換元の色域境界が変換先の色域境界に収まるようにする。
+ */
+class GamutMapping: public ImageProcess{
+public:
+	GamutMapping(const Primaries& source, const Primaries& destination,
+			const TransferFunction& transfer, bool compression = true);
+	virtual ~GamutMapping();
+	virtual Image& process(Image& image)const;
+private:
+	const TransferFunction& transfer_;
+	float matrix_[3][3];
+	float threshold_[3];
+	float slope_[3];
+};
+
+/**
+ * 階調を bits ビットに落とす。値は 16bit のまま、各レベルを 0x0000-0xffff に均等に割り付けた値にする。
+ * BAYER と BLUE_NOISE は閾値行列による組織的ディザで、全画素を独立に処理できる。
+ * FLOYD_STEINBERG は誤差拡散で、上の行が 2 画素以上先行していれば下の行を並行して処理できるので、
+ * 行をスレッドに順番に割り付けたウェーブフロントで並列化する。
+ */
+class Dither: public ImageProcess{
+public:
+	enum Method{
+		BAYER,
+		BLUE_NOISE,
+		FLOYD_STEINBERG
+	};
+	Dither(byte_t bits, Method method = BLUE_NOISE): bits_(bits), method_(method){}
+	virtual Image& process(Image& image)const;
+private:
+	Image& ordered(Image& image, const std::vector<unsigned int>& matrix, unsigned int order)const;
+	Image& diffuse(Image& image)const;
+	byte_t bits_;
+	Method method_;
 };
 
 #endif
@@ -0,0 +1,30 @@
+#ifndef BPCGEN_LINEARIMAGE_HPP_
+#define BPCGEN_LINEARIMAGE_HPP_
+
+#include <vector>
+#include "Image.hpp"
+class TransferFunction;
+
+/**
+ * 線形光の RGB を float で保持する作業用画像。
+ * Image との相互変換は TransferFunction のテーブルを介して行う。
+ */
+class LinearImage{
+public:
+	typedef float value_type;
+	LinearImage(const column_t& a_width, const row_t& a_height):
+		data_(static_cast<std::size_t>(a_width)*a_height*3u), width_(a_width), height_(a_height){}
+	LinearImage(const Image& image, const TransferFunction& tf);
+	~LinearImage();
+	value_type* operator[](row_t row){return &data_[static_cast<std::size_t>(row)*width_*3u];}
+	const value_type* operator[](row_t row)const{return &data_[static_cast<std::size_t>(row)*width_*3u];}
+	Image encode(const TransferFunction& tf)const;
+	const column_t& width()const{return width_;}
+	const row_t& height()const{return height_;}
+private:
+	std::vector<value_type> data_;
+	column_t width_;
+	row_t height_;
+};
+
+#endif
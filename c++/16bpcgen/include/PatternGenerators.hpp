@@ -1,8 +1,10 @@
 #ifndef BPCGEN_PATTERN_GENERATORS_HPP_
 #define BPCGEN_PATTERN_GENERATORS_HPP_
 
+#include <vector>
 #include "PatternGenerator.hpp"
 #include "Image.hpp"
+#include "Primaries.hpp"
 
 class ColorBar: public PatternGenerator{
 public:
@@ -136,4 +138,24 @@ private:
 	const bool fill_enabled_;
 };
 
+extern const std::size_t color_matching_functions_size;
+extern const double color_matching_functions[][4];
+
+/**
+ * CIE 1931 xy 色度図(x: 0.0-0.8, y: 0.0-0.9)。
+ * スペクトル軌跡と純紫軌跡で囲まれた領域を行ごとに並列に走査して、各 xy を
+ * sRGB で表せる最も明るい色(色域外は白を足して不足分を補う)で塗りつぶし、
+ * gamut() で与えた原色の三角形と白色点を重ねる。
+ */
+class ChromaticityDiagram: public PatternGenerator{
+public:
+	ChromaticityDiagram(): gamuts_(), colors_(){}
+	virtual ~ChromaticityDiagram();
+	ChromaticityDiagram& gamut(const Primaries& primaries, const Image::pixel_type& pixel = white);
+	virtual Image& generate(Image& image)const;
+private:
+	std::vector<Primaries> gamuts_;
+	std::vector<Image::pixel_type> colors_;
+};
+
 #endif
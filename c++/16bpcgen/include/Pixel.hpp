@@ -1,11 +1,37 @@
 #ifndef BPCGEN_PIXEL_HPP_
 #define BPCGEN_PIXEL_HPP_
 
+#include <algorithm>
 #include <iomanip>
 #include <ostream>
 #include <stdexcept>
 #include "typedef.hpp"
 
+/**
+ * YCbCr 変換係数のポリシー。Pixel::ycbcr<BT709>() のようにテンプレート引数で渡すと、
+ * 係数がすべてインライン展開された定数になり、分岐のない変換ループが生成される。
+ */
+struct BT601{
+	static double  YR(){return  0.2990;} static double  YG(){return  0.5870;} static double  YB(){return  0.1140;}
+	static double CbR(){return -0.1687;} static double CbG(){return -0.3312;} static double CbB(){return  0.5000;}
+	static double CrR(){return  0.5000;} static double CrG(){return -0.4186;} static double CrB(){return -0.0813;}
+	static double RCr(){return  1.4020;} static double GCb(){return  0.3440;} static double GCr(){return  0.7140;} static double BCb(){return 1.7720;}
+};
+
+struct BT709{
+	static double  YR(){return  0.2126;} static double  YG(){return  0.7152;} static double  YB(){return  0.0722;}
+	static double CbR(){return -0.1146;} static double CbG(){return -0.3854;} static double CbB(){return  0.5000;}
+	static double CrR(){return  0.5000;} static double CrG(){return -0.4542;} static double CrB(){return -0.0458;}
+	static double RCr(){return  1.5748;} static double GCb(){return  0.1873;} static double GCr(){return  0.4681;} static double BCb(){return 1.8556;}
+};
+
+struct BT2020{
+	static double  YR(){return  0.2627;} static double  YG(){return  0.6780;} static double  YB(){return  0.0593;}
+	static double CbR(){return -0.1396;} static double CbG(){return -0.3603;} static double CbB(){return  0.5000;}
+	static double CrR(){return  0.5000;} static double CrG(){return -0.4597;} static double CrB(){return -0.0402;}
+	static double RCr(){return  1.4746;} static double GCb(){return  0.1645;} static double GCr(){return  0.5713;} static double BCb(){return 1.8814;}
+};
+
 template <typename T = uint16_t>
 class Pixel{
 public:
@@ -24,48 +50,15 @@ public:
 		switch(cs){
 		case CS_RGB:
 			break;
-		case CS_YCBCR_BT601:{
-			if(r_y  < 16.0*max/255.0 || 235.0*max/255.0 < r_y  ||
-			   g_cb < 16.0*max/255.0 || 240.0*max/255.0 < g_cb ||
-			   b_cr < 16.0*max/255.0 || 240.0*max/255.0 < b_cr){
-				throw std::invalid_argument(__func__ + std::string(": can not set pixel color. color range violation."));
-			}
-			const double  Ytmp = (r_y  -  16.0*max/255.0)*255.0/219.0;
-			const double Cbtmp = (g_cb - 128.0*max/255.0)*255.0/224.0;
-			const double Crtmp = (b_cr - 128.0*max/255.0)*255.0/224.0;
-			R_ = static_cast<value_type>(std::min(std::max(Ytmp               + 1.402*Crtmp, 0.0), static_cast<double>(max)));
-			G_ = static_cast<value_type>(std::min(std::max(Ytmp - 0.344*Cbtmp - 0.714*Crtmp, 0.0), static_cast<double>(max)));
-			B_ = static_cast<value_type>(std::min(std::max(Ytmp + 1.772*Cbtmp,               0.0), static_cast<double>(max)));
+		case CS_YCBCR_BT601:
+			*this = checked_ycbcr<BT601>(r_y, g_cb, b_cr);
 			break;
-		}
-		case CS_YCBCR_BT709:{
-			if(r_y  < 16.0*max/255.0 || 235.0*max/255.0 < r_y  ||
-			   g_cb < 16.0*max/255.0 || 240.0*max/255.0 < g_cb ||
-			   b_cr < 16.0*max/255.0 || 240.0*max/255.0 < b_cr){
-				throw std::invalid_argument(__func__ + std::string(": can not set pixel color. color range violation."));
-			}
-			const double  Ytmp = (r_y  -  16.0*max/255.0)*255.0/219.0;
-			const double Cbtmp = (g_cb - 128.0*max/255.0)*255.0/224.0;
-			const double Crtmp = (b_cr - 128.0*max/255.0)*255.0/224.0;
-			R_ = static_cast<value_type>(std::min(std::max(Ytmp                + 1.5748*Crtmp, 0.0), static_cast<double>(max)));
-			G_ = static_cast<value_type>(std::min(std::max(Ytmp - 0.1873*Cbtmp - 0.4681*Crtmp, 0.0), static_cast<double>(max)));
-			B_ = static_cast<value_type>(std::min(std::max(Ytmp + 1.8556*Cbtmp,                0.0), static_cast<double>(max)));
+		case CS_YCBCR_BT709:
+			*this = checked_ycbcr<BT709>(r_y, g_cb, b_cr);
 			break;
-		}
-		case CS_YCBCR_BT2020:{
-			if(r_y  < 16.0*max/255.0 || 235.0*max/255.0 < r_y  ||
-			   g_cb < 16.0*max/255.0 || 240.0*max/255.0 < g_cb ||
-			   b_cr < 16.0*max/255.0 || 240.0*max/255.0 < b_cr){
-				throw std::invalid_argument(__func__ + std::string(": can not set pixel color. color range violation."));
-			}
-			const double  Ytmp = (r_y  -  16.0*max/255.0)*255.0/219.0;
-			const double Cbtmp = (g_cb - 128.0*max/255.0)*255.0/224.0;
-			const double Crtmp = (b_cr - 128.0*max/255.0)*255.0/224.0;
-			R_ = static_cast<value_type>(std::min(std::max(Ytmp                + 1.4746*Crtmp, 0.0), static_cast<double>(max)));
-			G_ = static_cast<value_type>(std::min(std::max(Ytmp - 0.1645*Cbtmp - 0.5713*Crtmp, 0.0), static_cast<double>(max)));
-			B_ = static_cast<value_type>(std::min(std::max(Ytmp + 1.8814*Cbtmp,                0.0), static_cast<double>(max)));
+		case CS_YCBCR_BT2020:
+			*this = checked_ycbcr<BT2020>(r_y, g_cb, b_cr);
 			break;
-		}
 		case CS_HSV:{
 			const value_type maximum = b_cr;
 			const value_type minimum = static_cast<value_type>(maximum - ( g_cb / max * maximum));
@@ -258,15 +251,38 @@ public:
 	void R(value_type r){R_ = r;}
 	void G(value_type g){G_ = g;}
 	void B(value_type b){B_ = b;}
-	value_type   Y601()const{return ( 0.2990*R_ + 0.5870*G_ + 0.1140*B_)*219.0/255.0 +  16.0*max/255.0;}
-	value_type  Cb601()const{return (-0.1687*R_ - 0.3312*G_ + 0.5000*B_)*224.0/255.0 + 128.0*max/255.0;}
-	value_type  Cr601()const{return ( 0.5000*R_ - 0.4186*G_ - 0.0813*B_)*224.0/255.0 + 128.0*max/255.0;}
-	value_type   Y709()const{return ( 0.2126*R_ + 0.7152*G_ + 0.0722*B_)*219.0/255.0 +  16.0*max/255.0;}
-	value_type  Cb709()const{return (-0.1146*R_ - 0.3854*G_ + 0.5000*B_)*224.0/255.0 + 128.0*max/255.0;}
-	value_type  Cr709()const{return ( 0.5000*R_ - 0.4542*G_ - 0.0458*B_)*224.0/255.0 + 128.0*max/255.0;}
-	value_type  Y2020()const{return ( 0.2627*R_ + 0.6780*G_ + 0.0593*B_)*219.0/255.0 +  16.0*max/255.0;}
-	value_type Cb2020()const{return (-0.1396*R_ - 0.3603*G_ + 0.5000*B_)*224.0/255.0 + 128.0*max/255.0;}
-	value_type Cr2020()const{return ( 0.5000*R_ - 0.4597*G_ - 0.0402*B_)*224.0/255.0 + 128.0*max/255.0;}
+	template <typename CS>
+	value_type Luma()const{return static_cast<value_type>((CS:: YR()*R_ + CS:: YG()*G_ + CS:: YB()*B_)*219.0/255.0 +  16.0*max/255.0);}
+	template <typename CS>
+	value_type   Cb()const{return static_cast<value_type>((CS::CbR()*R_ + CS::CbG()*G_ + CS::CbB()*B_)*224.0/255.0 + 128.0*max/255.0);}
+	template <typename CS>
+	value_type   Cr()const{return static_cast<value_type>((CS::CrR()*R_ + CS::CrG()*G_ + CS::CrB()*B_)*224.0/255.0 + 128.0*max/255.0);}
+	value_type   Y601()const{return Luma<BT601>();}
+	value_type  Cb601()const{return Cb<BT601>();}
+	value_type  Cr601()const{return Cr<BT601>();}
+	value_type   Y709()const{return Luma<BT709>();}
+	value_type  Cb709()const{return Cb<BT709>();}
+	value_type  Cr709()const{return Cr<BT709>();}
+	value_type  Y2020()const{return Luma<BT2020>();}
+	value_type Cb2020()const{return Cb<BT2020>();}
+	value_type Cr2020()const{return Cr<BT2020>();}
+	static bool ycbcr_in_range(value_type y, value_type cb, value_type cr)
+	{
+		return (16.0*max/255.0 <= y)  & (y  <= 235.0*max/255.0) &
+			   (16.0*max/255.0 <= cb) & (cb <= 240.0*max/255.0) &
+			   (16.0*max/255.0 <= cr) & (cr <= 240.0*max/255.0);
+	}
+	template <typename CS>
+	static Pixel ycbcr(value_type y, value_type cb, value_type cr)
+	{
+		const double  Ytmp = (y  -  16.0*max/255.0)*255.0/219.0;
+		const double Cbtmp = (cb - 128.0*max/255.0)*255.0/224.0;
+		const double Crtmp = (cr - 128.0*max/255.0)*255.0/224.0;
+		return Pixel(
+			clamp(Ytmp                   + CS::RCr()*Crtmp),
+			clamp(Ytmp - CS::GCb()*Cbtmp - CS::GCr()*Crtmp),
+			clamp(Ytmp + CS::BCb()*Cbtmp));
+	}
 	double H()const
 	{
 		const value_type maximum = std::max(std::max(R_, G_), B_);
@@ -291,6 +307,15 @@ public:
 	value_type Y()const{return 1.0000*R_ + 4.5907*G_ + 0.0601*B_;}
 	value_type Z()const{return 0.0000*R_ + 0.0565*G_ + 5.5943*B_;}
 private:
+	static value_type clamp(double value){return static_cast<value_type>(std::min(std::max(value, 0.0), static_cast<double>(max)));}
+	template <typename CS>
+	static Pixel checked_ycbcr(value_type y, value_type cb, value_type cr)
+	{
+		if(!ycbcr_in_range(y, cb, cr)){
+			throw std::invalid_argument(__func__ + std::string(": can not set pixel color. color range violation."));
+		}
+		return ycbcr<CS>(y, cb, cr);
+	}
 	value_type R_;
 	value_type G_;
 	value_type B_;
@@ -7,6 +7,36 @@ class PixelConverter{
 public:
 	virtual ~PixelConverter(){}
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const = 0;
+	/**
+	 * [first, last) の画素をまとめて変換する。Tone は 1 行ごとにこれを呼ぶ。
+	 * Tone を変換の型のテンプレートにして convert() を静的に束縛する代わりに、仮想呼び出しを 1 行 1 回に減らしている。
+	 * 派生クラスの convert_span() は動的な型が自身と一致するときだけ独自のループを使い、
+	 * 一致しない(convert() だけを上書きした更なる派生クラスの)ときはこの実装に任せる。
+	 */
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+	{
+		for(Image::pixel_type* p = first; p != last; ++p){
+			convert(*p);
+		}
+	}
+	/**
+	 * 各チャンネルの出力が同じチャンネルの入力だけで決まるなら真。
+	 * 真の変換は LookUpTable に合成できる。
+	 */
+	virtual bool separable()const{return false;}
 };
 
+/**
+ * converter の静的な型の convert() を修飾名で(仮想呼び出しせずに)呼ぶ行ループ。
+ * convert() の定義が見える翻訳単位で convert_span() の実装に使えば、変換が
+ * ループ内にインライン展開される。converter の動的な型が Converter のときだけ使うこと。
+ */
+template <typename Converter>
+inline void convert_each(const Converter& converter, Image::pixel_type* first, Image::pixel_type* last)
+{
+	for(Image::pixel_type* p = first; p != last; ++p){
+		converter.Converter::convert(*p);
+	}
+}
+
 #endif
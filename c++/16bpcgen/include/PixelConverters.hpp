@@ -4,6 +4,8 @@
 #include <vector>
 #include "PixelConverter.hpp"
 
+class TransferFunction;
+
 class Channel: public PixelConverter{
 public:
 	enum{
@@ -14,6 +16,8 @@ public:
 	typedef byte_t Ch;
 	Channel(Ch c = R | G | B): ch_(c){}
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
+	virtual bool separable()const{return true;}
 	Ch ch()const{return ch_;}
 private:
 	const Ch ch_;
@@ -22,6 +26,7 @@ private:
 class GrayScale: public PixelConverter{
 public:
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
 };
 
 class Threshold: public Channel{
@@ -29,6 +34,8 @@ public:
 	Threshold(Image::pixel_type::value_type threshold, Ch c):
 		Channel(c), threshold_(threshold){}
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
+	virtual bool separable()const{return false;}
 private:
 	const Image::pixel_type::value_type threshold_;
 };
@@ -38,6 +45,7 @@ public:
 	Offset(Image::pixel_type::value_type offset, bool invert = false, Ch c = R | G | B):
 		Channel(c), offset_(offset), invert_(invert){}
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
 private:
 	const Image::pixel_type::value_type offset_;
 	const bool invert_;
@@ -47,13 +55,55 @@ class Reversal: public Channel{
 public:
 	Reversal(Ch c = R | G | B): Channel(c){}
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
 };
 
 class Gamma: public Channel{
 public:
+	enum Direction{
+		DECODE,
+		ENCODE
+	};
 	Gamma(const std::vector<Image::pixel_type::value_type>& lut, Ch c = R | G | B);
+	/**
+	 * tf の符号値 -> 線形光の符号値(DECODE)、またはその逆(ENCODE)のテーブルで変換する。
+	 * テーブルは関数の種類と gamma ごとにプロセス内で共有され、最初に要求されたときに
+	 * 一度だけ作られるので、インスタンスを作ってもテーブルのコピーは発生しない。
+	 *   image >>= Gamma(TransferFunction::srgb(), Gamma::ENCODE);
+	 *   image >>= Gamma(TransferFunction::power(2.2), Gamma::DECODE, Channel::G);
+	 */
+	Gamma(const TransferFunction& tf, Direction direction, Ch c = R | G | B);
+	Gamma(const Gamma& other);
+	virtual ~Gamma();
+	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
+private:
+	Gamma& operator=(const Gamma&);
+	std::vector<uint32_t> owned_;
+	const uint32_t* lut_;
+	const uint32_t* identity_;
+};
+
+/**
+ * チャンネルごとに独立な変換(separable() が真のもの)の列を、65536 通りの入力全てについて
+ * 一度だけ評価した 3 x 64K のテーブルにまとめる。
+ * 何段つないでも画像への適用は 1 パスのテーブル引きで済む。
+ *   image >>= LookUpTable() >> Offset(0x1000) >> Gamma(lut) >> Reversal(Channel::B);
+ */
+class LookUpTable: public PixelConverter{
+public:
+	LookUpTable();
+	LookUpTable(const PixelConverter& converter);
+	LookUpTable(const LookUpTable& lut);
+	virtual ~LookUpTable();
+	LookUpTable  operator>> (const PixelConverter& converter)const;
+	LookUpTable& operator>>=(const PixelConverter& converter);
 	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+	virtual void convert_span(Image::pixel_type* first, Image::pixel_type* last)const;
+	virtual bool separable()const{return true;}
+	const Image::pixel_type::value_type* table(byte_t channel)const{return &lut_[channel*size];}
 private:
+	static const std::size_t size = 0x10000;
 	std::vector<Image::pixel_type::value_type> lut_;
 };
 
@@ -0,0 +1,43 @@
+#ifndef BPCGEN_PRIMARIES_HPP_
+#define BPCGEN_PRIMARIES_HPP_
+
+/**
+ * RGB 原色と白色点の xy 色度。
+ */
+class Primaries{
+public:
+	typedef double Matrix[3][3];
+	Primaries(double rx, double ry, double gx, double gy, double bx, double by, double wx, double wy);
+	static const Primaries& bt709();
+	static const Primaries& dci_p3();
+	static const Primaries& display_p3();
+	static const Primaries& bt2020();
+	/**
+	 * 線形光の RGB から XYZ (Y = 1.0 が白) への変換行列を求める。
+	 */
+	void rgb_to_xyz(Matrix& m)const;
+	void xyz_to_rgb(Matrix& m)const;
+	/**
+	 * Bradford 変換で white の白色点から this の白色点へ XYZ を順応させる行列を求める。
+	 */
+	void adaptation_from(const Primaries& white, Matrix& m)const;
+	/**
+	 * source の線形光 RGB から this の線形光 RGB への変換行列(白色点の順応を含む)を求める。
+	 */
+	void conversion_from(const Primaries& source, Matrix& m)const;
+	double red_x()const{return r_[0];}
+	double red_y()const{return r_[1];}
+	double green_x()const{return g_[0];}
+	double green_y()const{return g_[1];}
+	double blue_x()const{return b_[0];}
+	double blue_y()const{return b_[1];}
+	double white_x()const{return w_[0];}
+	double white_y()const{return w_[1];}
+private:
+	double r_[2];
+	double g_[2];
+	double b_[2];
+	double w_[2];
+};
+
+#endif
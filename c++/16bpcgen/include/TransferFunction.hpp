@@ -0,0 +1,50 @@
+#ifndef BPCGEN_TRANSFERFUNCTION_HPP_
+#define BPCGEN_TRANSFERFUNCTION_HPP_
+
+#include <vector>
+#include "Pixel.hpp"
+
+/**
+ * 符号値(0x0000-0xffff)と線形光(0.0-1.0)の変換。
+ * 復号は 65536 要素のテーブル引き、符号化は float の指数部と仮数部上位ビットで
+ * 区間を選ぶ区分線形近似で行うので、画素ごとの pow() は発生しない。
+ * 線形光の 1.0 は PQ では 10000cd/m^2、HLG ではシーン光の最大値を表す。
+ */
+class TransferFunction{
+public:
+	typedef Pixel<>::value_type value_type;
+	enum Type{
+		TF_LINEAR,
+		TF_POWER,
+		TF_SRGB,
+		TF_BT1886,
+		TF_PQ,
+		TF_HLG
+	};
+	explicit TransferFunction(Type type, double gamma = 2.2);
+	TransferFunction(const TransferFunction& tf);
+	~TransferFunction();
+	static const TransferFunction& linear();
+	static const TransferFunction& srgb();
+	static const TransferFunction& bt1886();
+	static const TransferFunction& pq();
+	static const TransferFunction& hlg();
+	/**
+	 * TF_POWER のインスタンスを gamma ごとにプロセス内で共有する。
+	 */
+	static const TransferFunction& power(double gamma);
+	Type type()const{return type_;}
+	double gamma()const{return gamma_;}
+	double to_linear(double code)const;
+	double from_linear(double linear)const;
+	float decode(value_type code)const{return decode_[code];}
+	value_type encode(float linear)const;
+private:
+	Type type_;
+	double gamma_;
+	std::vector<float> decode_;
+	std::vector<float> encode_;
+	float encode_zero_;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "FFT.hpp"
+
+namespace{
+
+/**
+ * transform2d() で一度に work に写す列の数。
+ */
+const std::size_t fft_columns = 16;
+
+}
+
+FFT::FFT(std::size_t size): size_(size), reversal_(size), forward_(size/2), inverse_(size/2)
+{
+	if(!size_ || (size_ & (size_ - 1))){
+		throw std::invalid_argument(__func__ + std::string(": can not create FFT. size must be a power of 2."));
+	}
+	for(std::size_t i = 0, j = 0; i < size_; ++i){
+		reversal_[i] = j;
+		std::size_t bit = size_ >> 1;
+		for(; bit && (j & bit); bit >>= 1){
+			j ^= bit;
+		}
+		j |= bit;
+	}
+	const double pi = std::acos(-1.0);
+	for(std::size_t k = 0; k < forward_.size(); ++k){
+		const double angle = -2.0*pi*static_cast<double>(k)/static_cast<double>(size_);
+		forward_[k] = complex_type(std::cos(angle), std::sin(angle));
+		inverse_[k] = std::conj(forward_[k]);
+	}
+}
+
+FFT::~FFT(){}
+
+/**
+ * 複素数の積は std::complex の演算子を使うと NaN/Inf の扱いのために関数呼び出しになるので、
+ * 実部と虚部で書き下す。
+ */
+void FFT::transform(complex_type* data, bool inverse)const
+{
+	for(std::size_t i = 0; i < size_; ++i){
+		if(i < reversal_[i]){
+			std::swap(data[i], data[reversal_[i]]);
+		}
+	}
+	const complex_type* const twiddles = size_ < 2 ? 0 : inverse ? &inverse_[0] : &forward_[0];
+	for(std::size_t half = 1; half < size_; half *= 2){
+		const std::size_t step = size_/(half*2);
+		for(std::size_t first = 0; first < size_; first += half*2){
+			complex_type* const a = data + first;
+			complex_type* const b = a + half;
+			for(std::size_t k = 0; k < half; ++k){
+				const double wr = twiddles[k*step].real(), wi = twiddles[k*step].imag();
+				const double br = b[k].real()*wr - b[k].imag()*wi;
+				const double bi = b[k].real()*wi + b[k].imag()*wr;
+				const double ar = a[k].real(), ai = a[k].imag();
+				a[k] = complex_type(ar + br, ai + bi);
+				b[k] = complex_type(ar - br, ai - bi);
+			}
+		}
+	}
+}
+
+void FFT::transform2d(complex_type* data, std::vector<complex_type>& work, bool inverse)const
+{
+	for(std::size_t y = 0; y < size_; ++y){
+		transform(data + y*size_, inverse);
+	}
+	const std::size_t columns = std::min(fft_columns, size_);
+	work.resize(columns*size_);
+	for(std::size_t x0 = 0; x0 < size_; x0 += columns){
+		for(std::size_t y = 0; y < size_; ++y){
+			for(std::size_t c = 0; c < columns; ++c){
+				work[c*size_ + y] = data[y*size_ + x0 + c];
+			}
+		}
+		for(std::size_t c = 0; c < columns; ++c){
+			transform(&work[c*size_], inverse);
+		}
+		for(std::size_t y = 0; y < size_; ++y){
+			for(std::size_t c = 0; c < columns; ++c){
+				data[y*size_ + x0 + c] = work[c*size_ + y];
+			}
+		}
+	}
+}
@@ -1,396 +1,3134 @@
 #include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
 #include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "FFT.hpp"
 #include "Image.hpp"
 #include "ImageProcesses.hpp"
 #include "PatternGenerators.hpp"
 #include "PixelConverter.hpp"
+#include "Primaries.hpp"
+#include "TransferFunction.hpp"
+
+namespace{
+
+typedef Image::pixel_type::value_type value_type;
+
+/**
+ * Tone はこれより小さい範囲ではスレッドを立てる費用の方が大きいので 1 スレッドで処理する。
+ */
+const std::size_t tone_parallel_pixels = 0x10000;
+
+/**
+ * 並列区間の中で投げられた例外は区間の外へ持ち出せないので、最も上の行で投げられた例外の
+ * メッセージと、invalid_argument だったかどうかを控えておき、区間を出てから同じ型で投げ直す。
+ */
+class RowFailure{
+public:
+	explicit RowFailure(row_t none);
+	~RowFailure();
+	void record(row_t row, const std::exception* exception);
+	void raise()const;
+private:
+	row_t row_;
+	row_t none_;
+	bool invalid_;
+	std::string message_;
+};
+
+RowFailure::RowFailure(row_t none): row_(none), none_(none), invalid_(false), message_(){}
+
+RowFailure::~RowFailure(){}
+
+void RowFailure::record(row_t row, const std::exception* exception)
+{
+#pragma omp critical(row_failure)
+	if(row < row_){
+		row_ = row;
+		invalid_ = dynamic_cast<const std::invalid_argument*>(exception) != 0;
+		message_ = exception ? exception->what() : "unknown exception.";
+	}
+}
+
+void RowFailure::raise()const
+{
+	if(row_ == none_){
+		return;
+	}
+	if(invalid_){
+		throw std::invalid_argument(message_);
+	}
+	throw std::runtime_error(message_);
+}
+
+/**
+ * RegionTone の 1 行分。区間を左から順に converter で変換する。
+ */
+void convert_spans(const PixelConverter& converter, const Region::Spans& spans, const Row& row)
+{
+	for(Region::Spans::const_iterator i = spans.begin(); i != spans.end(); ++i){
+		converter.convert_span(&row[i->first], &row[i->second]);
+	}
+}
+
+/**
+ * 先行するスレッドの進み具合を回転待ちで待ち合わせるループのスレッド数。コアの数より多いと、
+ * 待っているスレッドが待たれているスレッドの時間を奪うので、コアの数で頭打ちにする。
+ */
+int spin_threads()
+{
+#ifdef _OPENMP
+	return std::min(omp_get_max_threads(), omp_get_num_procs());
+#else
+	return 1;
+#endif
+}
+
+value_type saturate(double value)
+{
+	const double rounded = std::floor(value + 0.5);
+	return static_cast<value_type>(rounded < 0.0 ? 0.0 : Image::pixel_type::max < rounded ? Image::pixel_type::max : rounded);
+}
+
+/**
+ * Filter は縦のタップ数分の行を行キャッシュに持って畳み込む。
+ * 行を帯に分けてスレッドに割り振り、帯の先頭ではキャッシュを作り直す。
+ */
+const row_t filter_band = 64;
+
+/**
+ * kernel を column * row^T に分解する。最大特異値に対応する特異ベクトルの組をべき乗法で求め、
+ * その積との差が全要素で最大要素の 1e-9 倍以内なら階数 1 とみなす。
+ */
+bool rank_one(const Filter::Kernel& kernel, Filter::KernelRow& column, Filter::KernelRow& row)
+{
+	const std::size_t height = kernel.size(), width = kernel[0].size();
+	std::size_t pivot = 0;
+	double norm = 0.0, maximum = 0.0;
+	for(std::size_t i = 0; i < height; ++i){
+		double sum = 0.0;
+		for(std::size_t j = 0; j < width; ++j){
+			sum += kernel[i][j]*kernel[i][j];
+			maximum = std::max(maximum, std::fabs(kernel[i][j]));
+		}
+		if(norm < sum){
+			norm = sum;
+			pivot = i;
+		}
+	}
+	if(!(0.0 < norm)){
+		return false;
+	}
+	Filter::KernelRow u(height), v(kernel[pivot]);
+	for(int iteration = 0; iteration < 16; ++iteration){
+		for(std::size_t i = 0; i < height; ++i){
+			u[i] = 0.0;
+			for(std::size_t j = 0; j < width; ++j){
+				u[i] += kernel[i][j]*v[j];
+			}
+		}
+		double length = 0.0;
+		for(std::size_t j = 0; j < width; ++j){
+			v[j] = 0.0;
+			for(std::size_t i = 0; i < height; ++i){
+				v[j] += kernel[i][j]*u[i];
+			}
+			length += v[j]*v[j];
+		}
+		length = std::sqrt(length);
+		for(std::size_t j = 0; j < width; ++j){
+			v[j] /= length;
+		}
+	}
+	for(std::size_t i = 0; i < height; ++i){
+		u[i] = 0.0;
+		for(std::size_t j = 0; j < width; ++j){
+			u[i] += kernel[i][j]*v[j];
+		}
+	}
+	for(std::size_t i = 0; i < height; ++i){
+		for(std::size_t j = 0; j < width; ++j){
+			if(1.0e-9*maximum < std::fabs(kernel[i][j] - u[i]*v[j])){
+				return false;
+			}
+		}
+	}
+	column.swap(u);
+	row.swap(v);
+	return true;
+}
+
+/**
+ * 整数の重みを整数の column * row^T に分解する。row を最初の 0 でない行を最大公約数で割ったものに取れば、
+ * 階数 1 の重みの各行は row の整数倍になるので、分解できるかどうかは割り算と検算だけで決まる。
+ */
+bool rank_one(const std::vector<int>& weights, std::size_t width, std::vector<int>& column, std::vector<int>& row)
+{
+	const std::size_t height = weights.size()/width;
+	std::size_t pivot = 0;
+	while(pivot < height && std::count(weights.begin() + static_cast<std::ptrdiff_t>(pivot*width),
+			weights.begin() + static_cast<std::ptrdiff_t>((pivot + 1)*width), 0) == static_cast<std::ptrdiff_t>(width)){
+		++pivot;
+	}
+	if(pivot == height){
+		return false;
+	}
+	int divisor = 0;
+	for(std::size_t j = 0; j < width; ++j){
+		for(int a = std::abs(weights[pivot*width + j]); a; ){
+			const int b = divisor%a;
+			divisor = a;
+			a = b;
+		}
+	}
+	std::vector<int> r(width), c(height);
+	std::size_t q = 0;
+	for(std::size_t j = 0; j < width; ++j){
+		r[j] = weights[pivot*width + j]/divisor;
+		if(!r[q]){
+			q = j;
+		}
+	}
+	for(std::size_t i = 0; i < height; ++i){
+		c[i] = weights[i*width + q]/r[q];
+		for(std::size_t j = 0; j < width; ++j){
+			if(c[i]*r[j] != weights[i*width + j]){
+				return false;
+			}
+		}
+	}
+	column.swap(c);
+	row.swap(r);
+	return true;
+}
+
+/**
+ * 長さ n の並びの位置 i を border に従って並びの中に写す。BORDER_CONSTANT で外側なら -1 を返す。
+ */
+std::ptrdiff_t border_index(std::ptrdiff_t i, std::ptrdiff_t n, Filter::Border border)
+{
+	if(0 <= i && i < n){
+		return i;
+	}
+	switch(border){
+	case Filter::BORDER_CLAMP:
+		return i < 0 ? 0 : n - 1;
+	case Filter::BORDER_MIRROR:{
+		if(n == 1){
+			return 0;
+		}
+		const std::ptrdiff_t period = (n - 1)*2;
+		const std::ptrdiff_t k = (i%period + period)%period;
+		return k < n ? k : period - k;
+	}
+	case Filter::BORDER_WRAP:
+		return (i%n + n)%n;
+	case Filter::BORDER_CONSTANT:
+	default:
+		return -1;
+	}
+}
+
+/**
+ * 画像の行 row (画像の外なら border で写した行)を左右に radius 画素ずつ border で延ばして padded に書く。
+ * 畳み込みの内側のループはこの行キャッシュだけを読むので、端の判定なしに連続したループになる。
+ */
+void pad_row(const Image& image, std::ptrdiff_t row, column_t radius, Filter::Border border,
+		const Pixel<>& constant, value_type* padded)
+{
+	const std::ptrdiff_t width = static_cast<std::ptrdiff_t>(image.width());
+	const std::ptrdiff_t h = border_index(row, static_cast<std::ptrdiff_t>(image.height()), border);
+	const value_type fill[] = {constant.R(), constant.G(), constant.B()};
+	if(h < 0){
+		for(std::size_t k = 0; k < (image.width() + radius*2)*3; ++k){
+			padded[k] = fill[k%3];
+		}
+		return;
+	}
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[static_cast<row_t>(h)][0]);
+	std::copy(src, src + image.width()*3, padded + radius*3);
+	for(std::ptrdiff_t x = -static_cast<std::ptrdiff_t>(radius); x < 0; ++x){
+		const std::ptrdiff_t left = border_index(x, width, border), right = border_index(width - 1 - x, width, border);
+		value_type* const l = padded + (x + static_cast<std::ptrdiff_t>(radius))*3;
+		value_type* const r = padded + (width - 1 - x + static_cast<std::ptrdiff_t>(radius))*3;
+		for(std::size_t c = 0; c < 3; ++c){
+			l[c] = left  < 0 ? fill[c] : src[left*3 + static_cast<std::ptrdiff_t>(c)];
+			r[c] = right < 0 ? fill[c] : src[right*3 + static_cast<std::ptrdiff_t>(c)];
+		}
+	}
+}
+
+/**
+ * 2 次元のカーネル weights (幅 kernel_width)を掛ける。行キャッシュは縦のタップ数分の境界を延ばした行で、
+ * 最後に scale を掛けて丸め・飽和させる。T が int なら固定小数点、double なら浮動小数点の積和になる。
+ */
+template <typename T>
+void convolve(const Image& image, Image& result, const std::vector<T>& weights, std::size_t kernel_width, double scale,
+		Filter::Border border, const Pixel<>& constant)
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t taps = weights.size()/kernel_width;
+	const std::ptrdiff_t radius_h = static_cast<std::ptrdiff_t>(taps/2);
+	const column_t radius_w = static_cast<column_t>(kernel_width/2);
+	const std::size_t stride = width*3, padded_stride = (width + radius_w*2)*3;
+	const row_t bands = (height + filter_band - 1)/filter_band;
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+	std::vector<std::size_t> nonzero;
+	for(std::size_t t = 0; t < weights.size(); ++t){
+		if(weights[t] < T() || T() < weights[t]){
+			nonzero.push_back(t);
+		}
+	}
+
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> cache(taps*padded_stride);
+		std::vector<T> accumulator(stride);
+#pragma omp for schedule(static)
+		for(row_t band = 0; band < bands; ++band){
+			const row_t first = band*filter_band;
+			const row_t last  = std::min(first + filter_band, height);
+			std::ptrdiff_t cached = static_cast<std::ptrdiff_t>(first) - radius_h;
+			for(row_t h = first; h < last; ++h){
+				for(; cached <= static_cast<std::ptrdiff_t>(h) + radius_h; ++cached){
+					pad_row(image, cached, radius_w, border, constant, &cache[static_cast<std::size_t>(cached + radius_h)%taps*padded_stride]);
+				}
+				std::fill(accumulator.begin(), accumulator.end(), T());
+				for(std::size_t t = 0; t < nonzero.size(); ++t){
+					const std::size_t i = nonzero[t]/kernel_width, j = nonzero[t]%kernel_width;
+					const T weight = weights[nonzero[t]];
+					const value_type* const in = &cache[(h + i)%taps*padded_stride + j*3];
+					for(std::size_t k = 0; k < stride; ++k){
+						accumulator[k] += weight*in[k];
+					}
+				}
+				value_type* const dst = reinterpret_cast<value_type*>(&result[h][0]);
+				for(std::size_t k = 0; k < stride; ++k){
+					dst[k] = saturate(accumulator[k]*scale);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * row で横方向に畳み込んだ行を縦のタップ数分の行キャッシュに持ち、column で縦方向に足し合わせる。
+ */
+template <typename T>
+void convolve_separable(const Image& image, Image& result, const std::vector<T>& row, const std::vector<T>& column, double scale,
+		Filter::Border border, const Pixel<>& constant)
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t taps = column.size();
+	const std::ptrdiff_t radius_h = static_cast<std::ptrdiff_t>(taps/2);
+	const column_t radius_w = static_cast<column_t>(row.size()/2);
+	const std::size_t stride = width*3;
+	const row_t bands = (height + filter_band - 1)/filter_band;
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> padded((width + radius_w*2)*3);
+		std::vector<T> cache(taps*stride);
+		std::vector<T> accumulator(stride);
+#pragma omp for schedule(static)
+		for(row_t band = 0; band < bands; ++band){
+			const row_t first = band*filter_band;
+			const row_t last  = std::min(first + filter_band, height);
+			std::ptrdiff_t cached = static_cast<std::ptrdiff_t>(first) - radius_h;
+			for(row_t h = first; h < last; ++h){
+				for(; cached <= static_cast<std::ptrdiff_t>(h) + radius_h; ++cached){
+					pad_row(image, cached, radius_w, border, constant, &padded[0]);
+					T* const line = &cache[static_cast<std::size_t>(cached + radius_h)%taps*stride];
+					std::fill(line, line + stride, T());
+					for(std::size_t j = 0; j < row.size(); ++j){
+						const T weight = row[j];
+						const value_type* const in = &padded[j*3];
+						for(std::size_t k = 0; k < stride; ++k){
+							line[k] += weight*in[k];
+						}
+					}
+				}
+				std::fill(accumulator.begin(), accumulator.end(), T());
+				for(std::size_t i = 0; i < taps; ++i){
+					const T weight = column[i];
+					const T* const in = &cache[(h + i)%taps*stride];
+					for(std::size_t k = 0; k < stride; ++k){
+						accumulator[k] += weight*in[k];
+					}
+				}
+				value_type* const dst = reinterpret_cast<value_type*>(&result[h][0]);
+				for(std::size_t k = 0; k < stride; ++k){
+					dst[k] = saturate(accumulator[k]*scale);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * box_w x box_h の窓の和を T で求めて平均にする。列ごとの縦の和を行キャッシュで 1 行ずつずらし、
+ * 行の中では同じチャンネルの累積和の差を取る。T が窓の和より狭くても、差は 2^n を法として正しい。
+ * 帯の先頭では縦の和を窓の行数分から作り直すので、帯は窓の 4 倍以上の高さにする。
+ */
+template <typename T>
+void box_sum(const Image& image, Image& result, column_t box_w, row_t box_h, Filter::Border border, const Pixel<>& constant)
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::ptrdiff_t radius_h = static_cast<std::ptrdiff_t>(box_h/2);
+	const column_t radius_w = box_w/2;
+	const std::size_t stride = width*3, lanes = (width + radius_w*2)*3;
+	const row_t band_rows = std::max(filter_band, box_h*4);
+	const row_t bands = (height + band_rows - 1)/band_rows;
+	const double scale = 1.0/(static_cast<double>(box_w)*box_h);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> entering(lanes), leaving(lanes);
+		std::vector<T> sums(lanes), prefix(lanes + 3);
+#pragma omp for schedule(static)
+		for(row_t band = 0; band < bands; ++band){
+			const row_t first = band*band_rows;
+			const row_t last  = std::min(first + band_rows, height);
+			std::fill(sums.begin(), sums.end(), T());
+			for(std::ptrdiff_t n = static_cast<std::ptrdiff_t>(first) - radius_h; n <= static_cast<std::ptrdiff_t>(first) + radius_h; ++n){
+				pad_row(image, n, radius_w, border, constant, &entering[0]);
+				for(std::size_t k = 0; k < lanes; ++k){
+					sums[k] += entering[k];
+				}
+			}
+			for(row_t h = first; h < last; ++h){
+				if(h != first){
+					pad_row(image, static_cast<std::ptrdiff_t>(h) + radius_h, radius_w, border, constant, &entering[0]);
+					pad_row(image, static_cast<std::ptrdiff_t>(h) - radius_h - 1, radius_w, border, constant, &leaving[0]);
+					for(std::size_t k = 0; k < lanes; ++k){
+						sums[k] = static_cast<T>(sums[k] + entering[k] - leaving[k]);
+					}
+				}
+				for(std::size_t k = 0; k < lanes; ++k){
+					prefix[k + 3] = static_cast<T>(prefix[k] + sums[k]);
+				}
+				const T* const tail = &prefix[box_w*3];
+				value_type* const dst = reinterpret_cast<value_type*>(&result[h][0]);
+				for(std::size_t k = 0; k < stride; ++k){
+					dst[k] = saturate(static_cast<double>(static_cast<T>(tail[k] - prefix[k]))*scale);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Morphology は縦方向には morphology_strip 列ずつ、横方向には morphology_rows 行ずつまとめて、
+ * 行と列を入れ替えたバッファで 1 次元の最小(最大)を求める。GaussianBlur と同じく 1 段の処理がベクトル演算になる。
+ */
+const column_t morphology_strip = 64;
+const row_t morphology_rows = 8;
+
+struct Minimum{
+	value_type operator()(value_type lhs, value_type rhs)const{return std::min(lhs, rhs);}
+};
+
+struct Maximum{
+	value_type operator()(value_type lhs, value_type rhs)const{return std::max(lhs, rhs);}
+};
+
+/**
+ * padded は (length + size - 1) x lanes の配列で、段 i から size 段の窓の op を data の段 i に書く。
+ * padded を size 段ずつの区画に分け、区画の先頭からの累積 prefix と末尾からの累積 suffix を作れば、
+ * 窓は 2 つの区画にまたがるので suffix[i] と prefix[i + size - 1] の op になる。
+ */
+template <typename Op>
+void van_herk(const value_type* padded, std::size_t length, std::size_t lanes, std::size_t size,
+		value_type* prefix, value_type* suffix, value_type* data)
+{
+	const Op op = Op();
+	const std::size_t total = length + size - 1;
+	for(std::size_t i = 0; i < total; ++i){
+		const value_type* const g = padded + i*lanes;
+		value_type* const r = prefix + i*lanes;
+		if(i % size){
+			const value_type* const r1 = r - lanes;
+			for(std::size_t l = 0; l < lanes; ++l){
+				r[l] = op(r1[l], g[l]);
+			}
+		}else{
+			std::copy(g, g + lanes, r);
+		}
+	}
+	for(std::size_t i = total; i--;){
+		const value_type* const g = padded + i*lanes;
+		value_type* const s = suffix + i*lanes;
+		if(i + 1 < total && (i + 1) % size){
+			const value_type* const s1 = s + lanes;
+			for(std::size_t l = 0; l < lanes; ++l){
+				s[l] = op(s1[l], g[l]);
+			}
+		}else{
+			std::copy(g, g + lanes, s);
+		}
+	}
+	for(std::size_t i = 0; i < length; ++i){
+		const value_type* const s = suffix + i*lanes;
+		const value_type* const r = prefix + (i + size - 1)*lanes;
+		value_type* const d = data + i*lanes;
+		for(std::size_t l = 0; l < lanes; ++l){
+			d[l] = op(s[l], r[l]);
+		}
+	}
+}
+
+/**
+ * 窓 size_w x size_h の中で基準点より前にある画素が before_w, before_h 個の op を image に掛ける。
+ * 画像の外は fill とする。
+ */
+template <typename Op>
+void morphology(Image& image, std::size_t size_w, std::size_t size_h, std::size_t before_w, std::size_t before_h, value_type fill)
+{
+	const std::size_t width = image.width(), height = image.height();
+	value_type* const pixels = reinterpret_cast<value_type*>(&image[0][0]);
+	const std::size_t stride = width*3;
+	// 大きさ 1 の方向は処理しない。
+	const std::size_t strips = size_h > 1 ? (width + morphology_strip - 1)/morphology_strip : 0;
+	const std::size_t blocks = size_w > 1 ? (height + morphology_rows - 1)/morphology_rows : 0;
+	const std::size_t capacity = std::max((height + size_h)*morphology_strip, (width + size_w)*morphology_rows)*3;
+	const bool large = tone_parallel_pixels <= width*height;
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> padded(capacity), prefix(capacity), suffix(capacity), line(capacity);
+#pragma omp for schedule(dynamic)
+		for(std::size_t strip = 0; strip < strips; ++strip){
+			const std::size_t x0 = strip*morphology_strip*3;
+			const std::size_t lanes = std::min(static_cast<std::size_t>(morphology_strip), width - strip*morphology_strip)*3;
+			std::fill(padded.begin(), padded.begin() + static_cast<std::ptrdiff_t>((height + size_h - 1)*lanes), fill);
+			for(std::size_t h = 0; h < height; ++h){
+				std::copy(pixels + h*stride + x0, pixels + h*stride + x0 + lanes, &padded[(h + before_h)*lanes]);
+			}
+			van_herk<Op>(&padded[0], height, lanes, size_h, &prefix[0], &suffix[0], &line[0]);
+			for(std::size_t h = 0; h < height; ++h){
+				std::copy(&line[h*lanes], &line[h*lanes] + lanes, pixels + h*stride + x0);
+			}
+		}
+#pragma omp for schedule(dynamic)
+		for(std::size_t block = 0; block < blocks; ++block){
+			const std::size_t h0 = block*morphology_rows;
+			const std::size_t rows = std::min(static_cast<std::size_t>(morphology_rows), height - h0);
+			const std::size_t lanes = rows*3;
+			std::fill(padded.begin(), padded.begin() + static_cast<std::ptrdiff_t>((width + size_w - 1)*lanes), fill);
+			for(std::size_t r = 0; r < rows; ++r){
+				const value_type* const src = pixels + (h0 + r)*stride;
+				for(std::size_t w = 0; w < width; ++w){
+					for(std::size_t c = 0; c < 3; ++c){
+						padded[(w + before_w)*lanes + r*3 + c] = src[w*3 + c];
+					}
+				}
+			}
+			van_herk<Op>(&padded[0], width, lanes, size_w, &prefix[0], &suffix[0], &line[0]);
+			for(std::size_t r = 0; r < rows; ++r){
+				value_type* const dst = pixels + (h0 + r)*stride;
+				for(std::size_t w = 0; w < width; ++w){
+					for(std::size_t c = 0; c < 3; ++c){
+						dst[w*3 + c] = line[w*lanes + r*3 + c];
+					}
+				}
+			}
+		}
+	}
+}
+
+/**
+ * 3 行 rows (左右に 1 画素ずつ延ばした行)から、中央の重みが center の Sobel/Prewitt の横と縦の微分を求める。
+ */
+template <int center>
+void gradient_row(const value_type* const* rows, std::size_t lanes, int* gx, int* gy)
+{
+	const value_type* const r0 = rows[0];
+	const value_type* const r1 = rows[1];
+	const value_type* const r2 = rows[2];
+	for(std::size_t k = 0; k < lanes; ++k){
+		gx[k] = (r0[k + 6] - r0[k]) + center*(r1[k + 6] - r1[k]) + (r2[k + 6] - r2[k]);
+		gy[k] = (r2[k] + center*r2[k + 3] + r2[k + 6]) - (r0[k] + center*r0[k + 3] + r0[k + 6]);
+	}
+}
+
+/**
+ * 微分の大きさを divisor で割って丸める。divisor は定数として展開させるためにテンプレート引数にする。
+ */
+template <int divisor>
+void gradient_magnitude(const int* gx, const int* gy, std::size_t lanes, Gradient::Norm norm, value_type* dst)
+{
+	switch(norm){
+	case Gradient::NORM_L1:
+		for(std::size_t k = 0; k < lanes; ++k){
+			const int m = (std::abs(gx[k]) + std::abs(gy[k]) + divisor/2)/divisor;
+			dst[k] = static_cast<value_type>(std::min(m, static_cast<int>(Image::pixel_type::max)));
+		}
+		break;
+	case Gradient::NORM_APPROXIMATE:
+		for(std::size_t k = 0; k < lanes; ++k){
+			const int ax = std::abs(gx[k]), ay = std::abs(gy[k]);
+			const int m = (std::max(ax, ay) + (std::min(ax, ay)*3 >> 3) + divisor/2)/divisor;
+			dst[k] = static_cast<value_type>(std::min(m, static_cast<int>(Image::pixel_type::max)));
+		}
+		break;
+	case Gradient::NORM_L2:
+	default:
+		for(std::size_t k = 0; k < lanes; ++k){
+			const float x = static_cast<float>(gx[k]), y = static_cast<float>(gy[k]);
+			const float m = std::sqrt(x*x + y*y)*(1.0f/divisor) + 0.5f;
+			dst[k] = static_cast<value_type>(std::min(m, static_cast<float>(Image::pixel_type::max)));
+		}
+		break;
+	}
+}
+
+/**
+ * 画素ごとに |gx| + |gy| が最大のチャンネルの向きを量子化する。境目の tan(22.5 度) は 53/128 で近似する。
+ */
+void gradient_orientation(const int* gx, const int* gy, std::size_t width, uint8_t* dst)
+{
+	for(std::size_t w = 0; w < width; ++w){
+		std::size_t c = w*3;
+		for(std::size_t k = w*3 + 1; k < w*3 + 3; ++k){
+			if(std::abs(gx[c]) + std::abs(gy[c]) < std::abs(gx[k]) + std::abs(gy[k])){
+				c = k;
+			}
+		}
+		const int ax = std::abs(gx[c]), ay = std::abs(gy[c]);
+		dst[w] = static_cast<uint8_t>(ay*128 <= ax*53 ? 0 : ax*128 <= ay*53 ? 2 : (0 < gx[c]) == (0 < gy[c]) ? 1 : 3);
+	}
+}
+
+/**
+ * Bilateral の格子は各軸の両端に bilateral_padding 個の 0 の格子点を足して、ぼかしと 3 線形補間が端の判定なしに済むようにする。
+ * 格子点は 3 チャンネル分の (値の和, 重み) を並べた 6 要素。
+ */
+const std::size_t bilateral_padding = 2;
+const std::size_t bilateral_cell = 6;
+
+/**
+ * step 要素おきに並んだ length 段の、各段 lanes 要素に [1 2 1]/4 を掛ける。両端の外は 0 とする。
+ * previous と current は lanes 要素の作業領域。
+ */
+void grid_blur(float* data, std::size_t length, std::size_t step, std::size_t lanes, float* previous, float* current)
+{
+	std::fill(previous, previous + lanes, 0.0f);
+	for(std::size_t i = 0; i < length; ++i){
+		float* const p = data + i*step;
+		const float* const next = i + 1 < length ? p + step : 0;
+		std::copy(p, p + lanes, current);
+		for(std::size_t l = 0; l < lanes; ++l){
+			p[l] = (previous[l] + current[l]*2.0f + (next ? next[l] : 0.0f))*0.25f;
+		}
+		std::swap(previous, current);
+	}
+}
+
+/**
+ * Filter はタップ数がこれ以上で分離できないカーネルを FFT で畳み込む。
+ */
+const std::size_t filter_fft_taps = 15*15;
+
+/**
+ * FFT で畳み込むとき、タイルは 1 辺 filter_fft_min 以上 filter_fft_max 以下の 2 のべき乗から、
+ * 画像全体の変換の手間が最小になるものを選ぶ。
+ */
+const std::size_t filter_fft_min = 32;
+const std::size_t filter_fft_max = 1024;
+
+/**
+ * GaussianBlur は縦方向には gaussian_strip 列ずつ、横方向には gaussian_rows 行ずつまとめて、
+ * 行と列を入れ替えたバッファで再帰させる。1 段の漸化式がチャンネルと列(行)にまたがるベクトル演算になる。
+ */
+const column_t gaussian_strip = 64;
+const row_t gaussian_rows = 8;
+
+/**
+ * data は前後に 3 段ずつの余白を持つ (length + 6) x lanes の配列で、段の並びに沿って前向きと後ろ向きに
+ * 漸化式 y[n] = b * x[n] + a[0] * y[n - 1] + a[1] * y[n - 2] + a[2] * y[n - 3] を掛ける。
+ * 前の余白は先頭の値が無限に続いたときの定常状態、後ろ向きの初期値は末尾の値が続くとして m で求める。
+ */
+void gaussian_recursion(double* data, std::size_t length, std::size_t lanes, double b, const double* a, const double (*m)[3])
+{
+	double* const first = data + lanes*3;
+	double* const last = first + length*lanes;
+	for(std::size_t k = 0; k < 3; ++k){
+		std::copy(first, first + lanes, data + k*lanes);
+	}
+	const std::vector<double> tail(last - lanes, last);
+	for(double* p = first; p != last; p += lanes){
+		const double* const p1 = p - lanes;
+		const double* const p2 = p1 - lanes;
+		const double* const p3 = p2 - lanes;
+		for(std::size_t l = 0; l < lanes; ++l){
+			p[l] = b*p[l] + a[0]*p1[l] + a[1]*p2[l] + a[2]*p3[l];
+		}
+	}
+	const double* const q1 = last - lanes;
+	const double* const q2 = q1 - lanes;
+	const double* const q3 = q2 - lanes;
+	for(std::size_t j = 0; j < 3; ++j){
+		double* const out = last + j*lanes;
+		for(std::size_t l = 0; l < lanes; ++l){
+			const double steady = tail[l];
+			out[l] = steady + m[j][0]*(q1[l] - steady) + m[j][1]*(q2[l] - steady) + m[j][2]*(q3[l] - steady);
+		}
+	}
+	for(double* p = last - lanes; first <= p; p -= lanes){
+		const double* const p1 = p + lanes;
+		const double* const p2 = p1 + lanes;
+		const double* const p3 = p2 + lanes;
+		for(std::size_t l = 0; l < lanes; ++l){
+			p[l] = b*p[l] + a[0]*p1[l] + a[1]*p2[l] + a[2]*p3[l];
+		}
+	}
+}
+
+/**
+ * Scale の係数は 2^resampling_bits を 1 とする固定小数点。16bit の画素との積和は
+ * Lanczos の負の係数を含めても int に収まる。
+ */
+const int resampling_bits = 14;
+
+double resampling_support(Scale::Interpolation interpolation)
+{
+	switch(interpolation){
+	case Scale::INTERPOLATION_BOX:
+		return 0.5;
+	case Scale::INTERPOLATION_BILINEAR:
+		return 1.0;
+	case Scale::INTERPOLATION_BICUBIC:
+		return 2.0;
+	case Scale::INTERPOLATION_LANCZOS3:
+		return 3.0;
+	case Scale::INTERPOLATION_NEAREST:
+	default:
+		return 0.0;
+	}
+}
+
+/**
+ * 双 3 次は Keys の a = -0.5 のもの。
+ */
+double resampling_weight(Scale::Interpolation interpolation, double x)
+{
+	const double pi = 3.14159265358979323846;
+	x = std::fabs(x);
+	switch(interpolation){
+	case Scale::INTERPOLATION_BOX:
+		return x <= 0.5 ? 1.0 : 0.0;
+	case Scale::INTERPOLATION_BILINEAR:
+		return x < 1.0 ? 1.0 - x : 0.0;
+	case Scale::INTERPOLATION_BICUBIC:
+		return x < 1.0 ? (1.5*x - 2.5)*x*x + 1.0 : x < 2.0 ? ((-0.5*x + 2.5)*x - 4.0)*x + 2.0 : 0.0;
+	case Scale::INTERPOLATION_LANCZOS3:
+		return x < 1.0e-9 ? 1.0 : x < 3.0 ? 3.0*std::sin(pi*x)*std::sin(pi*x/3.0)/(pi*pi*x*x) : 0.0;
+	case Scale::INTERPOLATION_NEAREST:
+	default:
+		return 0.0;
+	}
+}
+
+/**
+ * 長さ source の並びを長さ destination に写すときの、出力位置ごとの係数表。
+ * 出力 i は入力 first(i) から taps() 個の画素に coefficients(i) を掛けた和で、taps() は全ての出力で揃えてある。
+ * 画像の外にはみ出す係数は端の画素に寄せ、各出力の係数の和はちょうど 2^resampling_bits にする。
+ */
+class ResamplingTable{
+public:
+	ResamplingTable(std::size_t source, std::size_t destination, Scale::Interpolation interpolation);
+	~ResamplingTable();
+	std::size_t taps()const{return taps_;}
+	std::size_t first(std::size_t i)const{return first_[i];}
+	const int* coefficients(std::size_t i)const{return &coefficients_[i*taps_];}
+private:
+	std::size_t taps_;
+	std::vector<std::size_t> first_;
+	std::vector<int> coefficients_;
+};
+
+ResamplingTable::ResamplingTable(std::size_t source, std::size_t destination, Scale::Interpolation interpolation):
+	taps_(1), first_(destination), coefficients_()
+{
+	if(!source || !destination){
+		throw std::invalid_argument(__func__ + std::string(": can not scale. size must be positive."));
+	}
+	if(interpolation == Scale::INTERPOLATION_NEAREST){
+		for(std::size_t i = 0; i < destination; ++i){
+			first_[i] = i*source/destination;
+		}
+		coefficients_.assign(destination, 1 << resampling_bits);
+		return;
+	}
+	const double ratio = static_cast<double>(source)/static_cast<double>(destination);
+	const double scale = std::max(1.0, ratio);
+	const double radius = resampling_support(interpolation)*scale;
+	std::vector<std::vector<double> > weights(destination);
+	for(std::size_t i = 0; i < destination; ++i){
+		const double center = (static_cast<double>(i) + 0.5)*ratio - 0.5;
+		const std::ptrdiff_t last = static_cast<std::ptrdiff_t>(source) - 1;
+		const std::ptrdiff_t lo = static_cast<std::ptrdiff_t>(std::ceil(center - radius));
+		const std::ptrdiff_t hi = static_cast<std::ptrdiff_t>(std::floor(center + radius));
+		const std::ptrdiff_t head = std::min(std::max(lo, static_cast<std::ptrdiff_t>(0)), last);
+		const std::ptrdiff_t tail = std::min(std::max(hi, static_cast<std::ptrdiff_t>(0)), last);
+		first_[i] = static_cast<std::size_t>(head);
+		weights[i].assign(static_cast<std::size_t>(tail - head + 1), 0.0);
+		for(std::ptrdiff_t j = lo; j <= hi; ++j){
+			const std::ptrdiff_t k = std::min(std::max(j, head), tail);
+			weights[i][static_cast<std::size_t>(k - head)] += resampling_weight(interpolation, (static_cast<double>(j) - center)/scale);
+		}
+		taps_ = std::max(taps_, weights[i].size());
+	}
+	coefficients_.assign(destination*taps_, 0);
+	for(std::size_t i = 0; i < destination; ++i){
+		const std::vector<double>& w = weights[i];
+		double total = 0.0;
+		for(std::size_t k = 0; k < w.size(); ++k){
+			total += w[k];
+		}
+		// 前に詰めると入力の末尾を越える出力は、窓を前にずらして係数を後ろに寄せる。
+		const std::size_t offset = source < first_[i] + taps_ ? first_[i] + taps_ - source : 0;
+		first_[i] -= offset;
+		int* const c = &coefficients_[i*taps_ + offset];
+		int sum = 0;
+		std::size_t peak = 0;
+		for(std::size_t k = 0; k < w.size(); ++k){
+			c[k] = static_cast<int>(std::floor(w[k]/total*(1 << resampling_bits) + 0.5));
+			sum += c[k];
+			if(c[peak] < c[k]){
+				peak = k;
+			}
+		}
+		c[peak] += (1 << resampling_bits) - sum;
+	}
+}
+
+ResamplingTable::~ResamplingTable(){}
+
+value_type resampling_clip(int value)
+{
+	return static_cast<value_type>(std::min(std::max(value, 0) >> resampling_bits, static_cast<int>(Image::pixel_type::max)));
+}
+
+/**
+ * 1 行を横方向に table で写す。
+ */
+void resample_row(const value_type* src, value_type* dst, const ResamplingTable& table, std::size_t width)
+{
+	const std::size_t taps = table.taps();
+	const int half = 1 << (resampling_bits - 1);
+	for(std::size_t i = 0; i < width; ++i){
+		const value_type* const s = src + table.first(i)*3;
+		const int* const c = table.coefficients(i);
+		int r = half, g = half, b = half;
+		for(std::size_t k = 0; k < taps; ++k){
+			r += c[k]*s[k*3];
+			g += c[k]*s[k*3 + 1];
+			b += c[k]*s[k*3 + 2];
+		}
+		dst[i*3]     = resampling_clip(r);
+		dst[i*3 + 1] = resampling_clip(g);
+		dst[i*3 + 2] = resampling_clip(b);
+	}
+}
+
+/**
+ * taps 行 rows を係数 coefficients で足し合わせて 1 行にする。行の中の連続した lanes 要素ごとの積和なのでベクトル化できる。
+ */
+void resample_rows(const value_type* const* rows, const int* coefficients, std::size_t taps, value_type* dst, std::size_t lanes, int* accumulator)
+{
+	std::fill(accumulator, accumulator + lanes, 1 << (resampling_bits - 1));
+	for(std::size_t k = 0; k < taps; ++k){
+		const int c = coefficients[k];
+		if(!c){
+			continue;
+		}
+		const value_type* const src = rows[k];
+		for(std::size_t l = 0; l < lanes; ++l){
+			accumulator[l] += c*src[l];
+		}
+	}
+	for(std::size_t l = 0; l < lanes; ++l){
+		dst[l] = resampling_clip(accumulator[l]);
+	}
+}
+
+/**
+ * Resize は出力を resize_band 行ずつの帯に分けてスレッドに割り振る。帯の先頭では行の輪を作り直す。
+ */
+const row_t resize_band = 64;
+
+/**
+ * image を columns と rows で写した出力行を、下に向かう順に求める。入力行は columns で横に写したものを
+ * rows.taps() 行の輪に入れ、次の出力に要る行だけを新たに写す。
+ */
+class ResizeRows{
+public:
+	ResizeRows(const Image& image, const ResamplingTable& columns, const ResamplingTable& rows, column_t width);
+	~ResizeRows();
+	void operator()(row_t h, value_type* dst);
+private:
+	ResizeRows(const ResizeRows&);
+	ResizeRows& operator=(const ResizeRows&);
+	const Image& image_;
+	const ResamplingTable& columns_;
+	const ResamplingTable& rows_;
+	column_t width_;
+	std::size_t lanes_;
+	std::size_t next_;
+	std::vector<value_type> ring_;
+	std::vector<const value_type*> window_;
+	std::vector<int> accumulator_;
+};
+
+ResizeRows::ResizeRows(const Image& image, const ResamplingTable& columns, const ResamplingTable& rows, column_t width):
+	image_(image), columns_(columns), rows_(rows), width_(width), lanes_(width*3u), next_(0),
+	ring_(rows.taps()*lanes_), window_(rows.taps()), accumulator_(lanes_){}
+
+ResizeRows::~ResizeRows(){}
+
+void ResizeRows::operator()(row_t h, value_type* dst)
+{
+	const std::size_t taps = rows_.taps(), first = rows_.first(h);
+	for(std::size_t r = std::max(next_, first); r < first + taps; ++r){
+		resample_row(reinterpret_cast<const value_type*>(&image_[static_cast<row_t>(r)][0]), &ring_[(r % taps)*lanes_], columns_, width_);
+	}
+	next_ = std::max(next_, first + taps);
+	for(std::size_t k = 0; k < taps; ++k){
+		window_[k] = &ring_[((first + k) % taps)*lanes_];
+	}
+	resample_rows(&window_[0], rows_.coefficients(h), taps, dst, lanes_, &accumulator_[0]);
+}
+
+/**
+ * Warp は出力を warp_tile 四方のタイルに分けてスレッドに割り振る。
+ */
+const std::size_t warp_tile = 64;
+
+/**
+ * 入力の画素 (x, y) の値。画像の外なら background。
+ */
+const value_type* warp_pixel(const Image& image, std::ptrdiff_t x, std::ptrdiff_t y, const value_type* background)
+{
+	if(x < 0 || y < 0 || static_cast<std::ptrdiff_t>(image.width()) <= x || static_cast<std::ptrdiff_t>(image.height()) <= y){
+		return background;
+	}
+	return reinterpret_cast<const value_type*>(&image[static_cast<row_t>(y)][static_cast<column_t>(x)]);
+}
+
+/**
+ * RemapTable の端数は 1/2^remap_bits 単位。横と縦の重みの積と 16bit の画素の積が uint32_t に収まる。
+ */
+const int remap_bits = 8;
+
+/**
+ * RemapTable の入力の外を表す offset。
+ */
+const uint32_t remap_outside = 0xffffffffu;
+
+/**
+ * RemapTable のファイルの先頭 4 バイト。続いて幅、高さ、background の RGB と表の各要素をリトルエンディアンで書く。
+ */
+const char remap_magic[4] = {'R', 'M', 'A', 'P'};
+
+void put_le(std::vector<byte_t>& buffer, uint32_t value, std::size_t bytes)
+{
+	for(std::size_t i = 0; i < bytes; ++i){
+		buffer.push_back(static_cast<byte_t>(value >> (i*8)));
+	}
+}
+
+uint32_t get_le(const byte_t* data, std::size_t bytes)
+{
+	uint32_t value = 0;
+	for(std::size_t i = 0; i < bytes; ++i){
+		value |= static_cast<uint32_t>(data[i]) << (i*8);
+	}
+	return value;
+}
+
+/**
+ * 向きを変える処理の再帰は、辺が orientation_leaf 画素以下になったところで 1 画素ずつ写す。
+ * 葉の入力と出力はどちらも L1 に収まる。
+ */
+const std::size_t orientation_leaf = 32;
+
+/**
+ * 向きを変える処理は orientation_tile 四方のタイルをスレッドに割り振る。
+ */
+const std::size_t orientation_tile = 256;
+
+/**
+ * 行と列の入れ替えに続けて左右(ROTATE90)か上下(ROTATE270)を反転するか。
+ */
+enum Turn{
+	TURN_TRANSPOSE,
+	TURN_ROTATE90,
+	TURN_ROTATE270
+};
+
+/**
+ * width x height の src の [h0, h1) x [w0, w1) を、height x width の dst に turn の向きで写す。
+ */
+void turn_block(const Image::pixel_type* src, Image::pixel_type* dst, std::size_t width, std::size_t height,
+		std::size_t h0, std::size_t h1, std::size_t w0, std::size_t w1, Turn turn)
+{
+	if(h1 - h0 <= orientation_leaf && w1 - w0 <= orientation_leaf){
+		for(std::size_t w = w0; w < w1; ++w){
+			Image::pixel_type* const line = dst + (turn == TURN_ROTATE270 ? width - 1 - w : w)*height;
+			for(std::size_t h = h0; h < h1; ++h){
+				line[turn == TURN_ROTATE90 ? height - 1 - h : h] = src[h*width + w];
+			}
+		}
+	}else if(w1 - w0 < h1 - h0){
+		const std::size_t middle = h0 + (h1 - h0)/2;
+		turn_block(src, dst, width, height, h0, middle, w0, w1, turn);
+		turn_block(src, dst, width, height, middle, h1, w0, w1, turn);
+	}else{
+		const std::size_t middle = w0 + (w1 - w0)/2;
+		turn_block(src, dst, width, height, h0, h1, w0, middle, turn);
+		turn_block(src, dst, width, height, h0, h1, middle, w1, turn);
+	}
+}
+
+Image& turn_image(Image& image, Turn turn)
+{
+	const std::size_t width = image.width(), height = image.height();
+	const std::size_t tiles_x = (width + orientation_tile - 1)/orientation_tile, tiles_y = (height + orientation_tile - 1)/orientation_tile;
+	const std::size_t tiles = tiles_x*tiles_y;
+	const Image::pixel_type* const src = &image[0][0];
+	Image result(image.height(), image.width());
+	Image::pixel_type* const dst = &result[0][0];
+	const bool large = tone_parallel_pixels <= width*height;
+#pragma omp parallel for schedule(static) if(large)
+	for(std::size_t tile = 0; tile < tiles; ++tile){
+		const std::size_t w0 = tile%tiles_x*orientation_tile, h0 = tile/tiles_x*orientation_tile;
+		turn_block(src, dst, width, height, h0, std::min(h0 + orientation_tile, height), w0, std::min(w0 + orientation_tile, width), turn);
+	}
+	return image.swap(result);
+}
+
+/**
+ * size x size の p の [h0, h1) x [w0, w1) (対角より上)を、対角について反対側のブロックと入れ替える。
+ */
+void transpose_swap(Image::pixel_type* p, std::size_t size, std::size_t h0, std::size_t h1, std::size_t w0, std::size_t w1)
+{
+	if(h1 - h0 <= orientation_leaf && w1 - w0 <= orientation_leaf){
+		for(std::size_t h = h0; h < h1; ++h){
+			for(std::size_t w = std::max(w0, h + 1); w < w1; ++w){
+				std::swap(p[h*size + w], p[w*size + h]);
+			}
+		}
+	}else if(w1 - w0 < h1 - h0){
+		const std::size_t middle = h0 + (h1 - h0)/2;
+		transpose_swap(p, size, h0, middle, w0, w1);
+		transpose_swap(p, size, middle, h1, w0, w1);
+	}else{
+		const std::size_t middle = w0 + (w1 - w0)/2;
+		transpose_swap(p, size, h0, h1, w0, middle);
+		transpose_swap(p, size, h0, h1, middle, w1);
+	}
+}
+
+/**
+ * 正方形の画像の行と列をその場で入れ替える。対角より上のタイルごとに反対側と入れ替えるので、タイルどうしは独立。
+ */
+Image& transpose_square(Image& image)
+{
+	const std::size_t size = image.width();
+	const std::size_t tiles_x = (size + orientation_tile - 1)/orientation_tile;
+	const std::size_t tiles = tiles_x*tiles_x;
+	Image::pixel_type* const p = &image[0][0];
+	const bool large = tone_parallel_pixels <= size*size;
+#pragma omp parallel for schedule(dynamic) if(large)
+	for(std::size_t tile = 0; tile < tiles; ++tile){
+		const std::size_t i = tile/tiles_x, j = tile%tiles_x;
+		if(i <= j){
+			const std::size_t h0 = i*orientation_tile, w0 = j*orientation_tile;
+			transpose_swap(p, size, h0, std::min(h0 + orientation_tile, size), w0, std::min(w0 + orientation_tile, size));
+		}
+	}
+	return image;
+}
+
+Image& flip_horizontal(Image& image)
+{
+	const row_t height = image.height();
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(image.width())*height;
+#pragma omp parallel for schedule(static) if(large)
+	for(row_t h = 0; h < height; ++h){
+		Image::pixel_type* const first = &image[h][0];
+		std::reverse(first, first + image.width());
+	}
+	return image;
+}
+
+Image& flip_vertical(Image& image)
+{
+	const row_t height = image.height();
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(image.width())*height;
+#pragma omp parallel for schedule(static) if(large)
+	for(row_t h = 0; h < height/2; ++h){
+		Image::pixel_type* const first = &image[h][0];
+		std::swap_ranges(first, first + image.width(), &image[height - 1 - h][0]);
+	}
+	return image;
+}
+
+/**
+ * 3x3 の行列 matrix の逆行列を余因子行列から求める。行列式が 0 なら false。
+ */
+bool invert(const Warp::Matrix& matrix, Warp::Matrix& inverse)
+{
+	const double det =
+		matrix[0][0]*(matrix[1][1]*matrix[2][2] - matrix[1][2]*matrix[2][1]) -
+		matrix[0][1]*(matrix[1][0]*matrix[2][2] - matrix[1][2]*matrix[2][0]) +
+		matrix[0][2]*(matrix[1][0]*matrix[2][1] - matrix[1][1]*matrix[2][0]);
+	if(!(std::fabs(det) > 0.0)){
+		return false;
+	}
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			const int i1 = (j + 1)%3, i2 = (j + 2)%3;
+			const int j1 = (i + 1)%3, j2 = (i + 2)%3;
+			inverse[i][j] = (matrix[i1][j1]*matrix[i2][j2] - matrix[i1][j2]*matrix[i2][j1])/det;
+		}
+	}
+	return true;
+}
+
+/**
+ * 端数 t の位置に対する -1, 0, 1, 2 画素目の Keys (a = -0.5) の重み。
+ */
+void cubic_weights(double t, double* w)
+{
+	w[0] = ((-0.5*t + 1.0)*t - 0.5)*t;
+	w[1] = (1.5*t - 2.5)*t*t + 1.0;
+	w[2] = ((-1.5*t + 2.0)*t + 0.5)*t;
+	w[3] = (0.5*t - 0.5)*t*t;
+}
+
+/**
+ * 画素の中心を整数とする入力の位置 (u, v) の前後 taps/2 画素ずつを、taps が 2 なら双線形、4 なら双 3 次の重みで標本化する。
+ */
+template <std::size_t taps>
+void warp_sample(const Image& image, double u, double v, const value_type* background, value_type* dst)
+{
+	const double fu = std::floor(u), fv = std::floor(v);
+	const double tx = u - fu, ty = v - fv;
+	double wx[4], wy[4];
+	if(taps == 2){
+		wx[0] = 1.0 - tx;
+		wx[1] = tx;
+		wy[0] = 1.0 - ty;
+		wy[1] = ty;
+	}else{
+		cubic_weights(tx, wx);
+		cubic_weights(ty, wy);
+	}
+	const std::ptrdiff_t x = static_cast<std::ptrdiff_t>(fu) - static_cast<std::ptrdiff_t>(taps/2 - 1);
+	const std::ptrdiff_t y = static_cast<std::ptrdiff_t>(fv) - static_cast<std::ptrdiff_t>(taps/2 - 1);
+	const bool inside = 0 <= x && 0 <= y &&
+		x + static_cast<std::ptrdiff_t>(taps) <= static_cast<std::ptrdiff_t>(image.width()) &&
+		y + static_cast<std::ptrdiff_t>(taps) <= static_cast<std::ptrdiff_t>(image.height());
+	double sum[3] = {0.0, 0.0, 0.0};
+	for(std::size_t j = 0; j < taps; ++j){
+		double row[3] = {0.0, 0.0, 0.0};
+		const value_type* const line = inside ? reinterpret_cast<const value_type*>(&image[static_cast<row_t>(y) + static_cast<row_t>(j)][static_cast<column_t>(x)]) : 0;
+		for(std::size_t i = 0; i < taps; ++i){
+			const value_type* const p = inside ? line + i*3 : warp_pixel(image, x + static_cast<std::ptrdiff_t>(i), y + static_cast<std::ptrdiff_t>(j), background);
+			row[0] += wx[i]*p[0];
+			row[1] += wx[i]*p[1];
+			row[2] += wx[i]*p[2];
+		}
+		sum[0] += wy[j]*row[0];
+		sum[1] += wy[j]*row[1];
+		sum[2] += wy[j]*row[2];
+	}
+	dst[0] = saturate(sum[0]);
+	dst[1] = saturate(sum[1]);
+	dst[2] = saturate(sum[2]);
+}
+
+}
+
+Region::Region(column_t width, row_t height): width_(width), height_(height), rows_(height)
+{
+}
+
+Region::~Region(){}
+
+Region& Region::add(const Area& area)
+{
+	if(!(area.offset_x_ < width_ && area.offset_y_ < height_ &&
+			area.offset_x_ + area.width_ <= width_ && area.offset_y_ + area.height_ <= height_)){
+		throw std::invalid_argument(__func__ + std::string(": can not add area to region. invalid area specification."));
+	}
+	const column_t limit_w =
+		area.width_  == 0 && area.offset_x_ == 0
+						? width_  : area.offset_x_ + area.width_;
+	const row_t    limit_h =
+		area.height_ == 0 && area.offset_y_ == 0
+						? height_ : area.offset_y_ + area.height_;
+	if(area.offset_x_ < limit_w){
+		for(row_t h = area.offset_y_; h < limit_h; ++h){
+			insert(h, area.offset_x_, limit_w);
+		}
+	}
+	return *this;
+}
+
+Region& Region::add(const std::vector<bool>& mask)
+{
+	if(mask.size() != static_cast<std::size_t>(width_)*height_){
+		throw std::invalid_argument(__func__ + std::string(": can not add mask to region. mask size unmatch."));
+	}
+	std::vector<bool>::const_iterator m = mask.begin();
+	for(row_t h = 0; h < height_; ++h){
+		column_t w = 0;
+		while(w < width_){
+			for(; w < width_ && !*m; ++w, ++m){
+			}
+			const column_t first = w;
+			for(; w < width_ && *m; ++w, ++m){
+			}
+			if(first < w){
+				insert(h, first, w);
+			}
+		}
+	}
+	return *this;
+}
+
+/**
+ * 行 h の区間列は開始位置の昇順で互いに離れているように保つ。
+ */
+void Region::insert(row_t h, column_t first, column_t last)
+{
+	Spans& spans = rows_[h];
+	Spans::iterator i = std::lower_bound(spans.begin(), spans.end(), Span(first, first));
+	if(i != spans.begin() && first <= (i - 1)->second){
+		--i;
+		first = i->first;
+	}
+	Spans::iterator j = i;
+	for(; j != spans.end() && j->first <= last; ++j){
+		last = std::max(last, j->second);
+	}
+	spans.insert(spans.erase(i, j), Span(first, last));
+}
 
 bool AreaSpecifier::within(const Image& image)const
 {
-	return area_.offset_x_ < image.width()  &&
-		area_.offset_y_ < image.height() &&
-		area_.offset_x_ + area_.width_  <= image.width() &&
-		area_.offset_y_ + area_.height_ <= image.height();
+	return area_.offset_x_ < image.width()  &&
+		area_.offset_y_ < image.height() &&
+		area_.offset_x_ + area_.width_  <= image.width() &&
+		area_.offset_y_ + area_.height_ <= image.height();
+}
+
+Image& Tone::process(Image& image)const
+{
+	if(!within(image)){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Tone process. invalid area specification."));
+	}
+
+	const column_t limit_w =
+		area_.width_  == 0 && area_.offset_x_ == 0
+						? image.width()  : area_.offset_x_ + area_.width_;
+	const row_t    limit_h =
+		area_.height_ == 0 && area_.offset_y_ == 0
+						? image.height() : area_.offset_y_ + area_.height_;
+
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(limit_w - area_.offset_x_)*(limit_h - area_.offset_y_);
+	if(!large){
+		for(row_t h = area_.offset_y_; h < limit_h; ++h){
+			converter_.convert_span(&image[h][area_.offset_x_], &image[h][limit_w]);
+		}
+		return image;
+	}
+	RowFailure failure(limit_h);
+#pragma omp parallel for schedule(static)
+	for(row_t h = area_.offset_y_; h < limit_h; ++h){
+		try{
+			converter_.convert_span(&image[h][area_.offset_x_], &image[h][limit_w]);
+		}catch(const std::exception& e){
+			failure.record(h, &e);
+		}catch(...){
+			failure.record(h, 0);
+		}
+	}
+	failure.raise();
+	return image;
+}
+
+/**
+ * 行ごとの仕事量が区間の数と長さで偏るので、行は小さな塊で動的に割り振る。
+ */
+Image& RegionTone::process(Image& image)const
+{
+	if(image.width() != region_.width() || image.height() != region_.height()){
+		throw std::invalid_argument(__func__ + std::string(": can not apply RegionTone process. region size unmatch."));
+	}
+
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(image.width())*image.height();
+	if(!large){
+		for(row_t h = 0; h < image.height(); ++h){
+			convert_spans(converter_, region_.spans(h), image[h]);
+		}
+		return image;
+	}
+	RowFailure failure(image.height());
+#pragma omp parallel for schedule(dynamic, 16)
+	for(row_t h = 0; h < image.height(); ++h){
+		try{
+			convert_spans(converter_, region_.spans(h), image[h]);
+		}catch(const std::exception& e){
+			failure.record(h, &e);
+		}catch(...){
+			failure.record(h, 0);
+		}
+	}
+	failure.raise();
+	return image;
+}
+
+Image& Normalize::process(Image& image)const
+{
+	if(!within(image)){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Normalize process. invalid area specification."));
+	}
+
+	const column_t limit_w =
+		area_.width_  == 0 && area_.offset_x_ == 0
+						? image.width()  : area_.offset_x_ + area_.width_;
+	const row_t    limit_h =
+		area_.height_ == 0 && area_.offset_y_ == 0
+						? image.height() : area_.offset_y_ + area_.height_;
+
+	const Image::pixel_type::value_type max = *std::max_element(
+		reinterpret_cast<Image::pixel_type::value_type*>(&image[0][0]),
+		reinterpret_cast<Image::pixel_type::value_type*>(&image[image.height()][0]));
+
+	for(row_t h = area_.offset_y_; h < limit_h; ++h){
+		for(column_t w = area_.offset_x_; w < limit_w; ++w){
+			image[h][w] = Pixel<double>(image[h][w]) / static_cast<double>(max) * Image::pixel_type::max;
+		}
+	}
+	return image;
+}
+
+namespace{
+
+typedef std::pair<unsigned int, unsigned int> Comparator;
+
+const unsigned int median_max_radius     = 127u;
+const unsigned int median_network_radius = 2u;
+const column_t     median_chunk          = 256u;
+const column_t     median_tile           = 64u;
+const unsigned int median_radix_bits     = 4u;
+const std::size_t  median_radix          = 1u << median_radix_bits;
+const std::size_t  median_levels         = 16u/median_radix_bits;
+
+/**
+ * Batcher の merge exchange (Knuth 5.2.2 M) で size 本のソーティングネットワークを作り、
+ * 中央の線 size / 2 に影響しない比較器を後ろから刈り取る。比較器 (i, j) は i に小さい方を置く。
+ */
+std::vector<Comparator> median_network(unsigned int size)
+{
+	unsigned int t = 0;
+	while((1u << t) < size){
+		++t;
+	}
+	std::vector<Comparator> network;
+	for(unsigned int p = 1u << (t - 1); 0 < p; p >>= 1){
+		unsigned int q = 1u << (t - 1), r = 0, d = p;
+		for(;;){
+			for(unsigned int i = 0; i + d < size; ++i){
+				if((i & p) == r){
+					network.push_back(Comparator(i, i + d));
+				}
+			}
+			if(q == p){
+				break;
+			}
+			d = q - p;
+			q >>= 1;
+			r = p;
+		}
+	}
+	std::vector<bool> needed(size, false);
+	needed[size/2] = true;
+	std::vector<Comparator> pruned;
+	for(std::vector<Comparator>::reverse_iterator i = network.rbegin(); i != network.rend(); ++i){
+		if(needed[i->first] || needed[i->second]){
+			needed[i->first] = needed[i->second] = true;
+			pruned.push_back(*i);
+		}
+	}
+	return std::vector<Comparator>(pruned.rbegin(), pruned.rend());
+}
+
+/**
+ * 窓を画像の端で切り詰めて、その中の値を選ぶ。端の画素だけに使う。
+ */
+value_type median_clipped(const value_type* source, column_t width, row_t height,
+		column_t w, row_t h, std::size_t channel, unsigned int radius, std::vector<value_type>& values)
+{
+	values.clear();
+	const row_t    h_upperbound = std::min(h + radius + 1, height);
+	const column_t w_upperbound = std::min(w + radius + 1, width);
+	for(row_t i = h < radius ? 0 : h - radius; i < h_upperbound; ++i){
+		for(column_t j = w < radius ? 0 : w - radius; j < w_upperbound; ++j){
+			values.push_back(source[(static_cast<std::size_t>(i)*width + j)*3 + channel]);
+		}
+	}
+	std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(values.size()/2), values.end());
+	return values[values.size()/2];
+}
+
+/**
+ * 値 v を列ヒストグラムの各段に数え入れる(delta = 1)か、取り除く(delta = -1)。
+ * ヒストグラムは [組][列][16] の順に置き、窓の列を足し合わせるときに同じ組の隣の列が隣り合うようにする。
+ */
+void median_count(uint16_t* counts, std::size_t columns, std::size_t column, const std::size_t* offsets, value_type v, int delta)
+{
+	for(std::size_t k = 0; k < median_levels; ++k){
+		const std::size_t bin = offsets[k] + (static_cast<std::size_t>(v) >> (16u - median_radix_bits*(k + 1)));
+		uint16_t& count = counts[(bin/median_radix*columns + column)*median_radix + bin%median_radix];
+		count = static_cast<uint16_t>(count + delta);
+	}
+}
+
+}
+
+Image& Median::process(Image& image)const
+{
+	if(!within(image)){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Median filter. invalid area specification."));
+	}
+	if(median_max_radius < radius_){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Median filter. too large radius."));
+	}
+
+	const column_t limit_w =
+		area_.width_  == 0 && area_.offset_x_ == 0
+						? image.width()  : area_.offset_x_ + area_.width_;
+	const row_t limit_h =
+		area_.height_ == 0 && area_.offset_y_ == 0
+						? image.height() : area_.offset_y_ + area_.height_;
+
+	if(radius_ == 0){
+		return image;
+	}
+	const Image source = image;
+	return radius_ <= median_network_radius
+		? network(image, source, limit_w, limit_h)
+		: histogram(image, source, limit_w, limit_h);
+}
+
+/**
+ * 窓の全体が画像に収まる画素は、行の連続する値を窓の各位置ごとの配列に並べ、
+ * 比較器を配列どうしの min/max として適用する。比較器ごとのループがベクトル化される。
+ */
+Image& Median::network(Image& image, const Image& source, column_t limit_w, row_t limit_h)const
+{
+	static const std::vector<Comparator> networks[] = {
+		std::vector<Comparator>(), median_network(9), median_network(25)};
+	const std::vector<Comparator>& comparators = networks[radius_];
+	const unsigned int side = radius_*2 + 1;
+	const unsigned int size = side*side;
+	const column_t width = image.width();
+	const row_t height = image.height();
+	const std::size_t stride = static_cast<std::size_t>(width)*3;
+	const value_type* const src = reinterpret_cast<const value_type*>(&source[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&image[0][0]);
+	const column_t inner_x0 = std::max(area_.offset_x_, static_cast<column_t>(radius_));
+	const column_t inner_x1 = std::max(inner_x0, std::min(limit_w, width - std::min(width, radius_)));
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(limit_w - area_.offset_x_)*(limit_h - area_.offset_y_);
+
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> lanes(size*median_chunk);
+		std::vector<value_type> values;
+#pragma omp for schedule(static)
+		for(row_t h = area_.offset_y_; h < limit_h; ++h){
+			const bool inner_row = radius_ <= h && h + radius_ < height;
+			for(column_t w = area_.offset_x_; w < limit_w; ++w){
+				if(!inner_row || w < inner_x0 || inner_x1 <= w){
+					for(std::size_t c = 0; c < 3; ++c){
+						dst[(static_cast<std::size_t>(h)*width + w)*3 + c] = median_clipped(src, width, height, w, h, c, radius_, values);
+					}
+				}else{
+					w = inner_x1 - 1;
+				}
+			}
+			if(!inner_row){
+				continue;
+			}
+			for(std::size_t k = inner_x0*3u; k < inner_x1*3u; k += median_chunk){
+				const std::size_t n = std::min(static_cast<std::size_t>(median_chunk), inner_x1*3u - k);
+				for(unsigned int i = 0; i < side; ++i){
+					for(unsigned int j = 0; j < side; ++j){
+						const value_type* const from = src + (h + i - radius_)*stride + k + j*3 - radius_*3;
+						std::copy(from, from + n, &lanes[(i*side + j)*median_chunk]);
+					}
+				}
+				for(std::vector<Comparator>::const_iterator c = comparators.begin(); c != comparators.end(); ++c){
+					value_type* const a = &lanes[c->first*median_chunk];
+					value_type* const b = &lanes[c->second*median_chunk];
+					for(std::size_t t = 0; t < n; ++t){
+						const value_type lower = std::min(a[t], b[t]);
+						const value_type upper = std::max(a[t], b[t]);
+						a[t] = lower;
+						b[t] = upper;
+					}
+				}
+				const value_type* const median = &lanes[size/2*median_chunk];
+				std::copy(median, median + n, dst + h*stride + k);
+			}
+		}
+	}
+	return image;
+}
+
+/**
+ * Perreault-Hebert の定数時間メディアンを 16bit 値向けに多段にしたもの。値を上位から 4bit ずつ区切り、
+ * 16, 256, 4096, 65536 ビンの 4 段のヒストグラムを列ごとに持って、行の移動に合わせて 1 画素ずつ更新する。
+ * 窓のヒストグラムは、各段でメディアンの入った親ビンの下の 16 ビンだけを、必要になったときに
+ * 列の出入りで追いつかせる(離れすぎていれば数え直す)ので、画素あたり 4 段 x 16 ビンの手間で済む。
+ * 列ヒストグラムは 64 列ずつの縦の短冊ごとに持ち、短冊とチャンネルの組をスレッドに割り振る。
+ */
+Image& Median::histogram(Image& image, const Image& source, column_t limit_w, row_t limit_h)const
+{
+	typedef uint16_t count_type;
+	const column_t width = image.width();
+	const row_t height = image.height();
+	const column_t radius = radius_;
+	const value_type* const src = reinterpret_cast<const value_type*>(&source[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&image[0][0]);
+	const column_t tiles = (limit_w - area_.offset_x_ + median_tile - 1)/median_tile;
+	std::size_t offsets[median_levels + 1] = {0};
+	for(std::size_t k = 0; k < median_levels; ++k){
+		offsets[k + 1] = offsets[k] + (median_radix << (median_radix_bits*k));
+	}
+	const std::size_t bins = offsets[median_levels];
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(limit_w - area_.offset_x_)*(limit_h - area_.offset_y_);
+
+#pragma omp parallel if(large)
+	{
+		const std::size_t columns = median_tile + radius*2;
+		std::vector<count_type> column_counts(columns*bins, 0);
+		std::vector<count_type> kernel_counts(bins);
+		std::vector<std::size_t> checked(bins/median_radix);
+#pragma omp for schedule(dynamic)
+		for(column_t task = 0; task < tiles*3; ++task){
+			const std::size_t channel = task%3;
+			const column_t x0 = area_.offset_x_ + task/3*median_tile;
+			const column_t x1 = std::min(x0 + median_tile, limit_w);
+			const column_t cx0 = x0 < radius ? 0 : x0 - radius;
+			const column_t cx1 = std::min(x1 + radius, width);
+			const row_t y0 = area_.offset_y_;
+			count_type* const kernel = &kernel_counts[0];
+			std::fill(checked.begin(), checked.end(), 0);
+
+			// 列ヒストグラムを y0 - 1 行目の窓 [y0 - 1 - radius, y0 + radius) の状態にしておく。
+			for(row_t y = y0 < radius + 1 ? 0 : y0 - radius - 1; y < std::min(y0 + radius, height); ++y){
+				for(column_t x = cx0; x < cx1; ++x){
+					median_count(&column_counts[0], columns, x - cx0, offsets, src[(static_cast<std::size_t>(y)*width + x)*3 + channel], 1);
+				}
+			}
+			for(row_t y = y0; y < limit_h; ++y){
+				for(column_t x = cx0; x < cx1; ++x){
+					if(radius < y){
+						median_count(&column_counts[0], columns, x - cx0, offsets, src[(static_cast<std::size_t>(y - radius - 1)*width + x)*3 + channel], -1);
+					}
+					if(y + radius < height){
+						median_count(&column_counts[0], columns, x - cx0, offsets, src[(static_cast<std::size_t>(y + radius)*width + x)*3 + channel], 1);
+					}
+				}
+				const column_t rows = std::min(y + radius + 1, height) - (y < radius ? 0 : y - radius);
+				// checked には最後に追いつかせた位置 + 1 を行の通し番号で持つ。前の行の値は古いものとして扱う。
+				const std::size_t row_base = static_cast<std::size_t>(y)*width;
+
+				for(column_t x = x0; x < x1; ++x){
+					const column_t lo = x < radius ? 0 : x - radius;
+					const column_t hi = std::min(x + radius + 1, width);
+					const unsigned int rank = rows*(hi - lo)/2;
+					unsigned int accumulated = 0;
+					std::size_t prefix = 0;
+					for(std::size_t k = 0; k < median_levels; ++k){
+						const std::size_t slice = offsets[k] + prefix*median_radix;
+						count_type* const counts = kernel + slice;
+						std::size_t& last = checked[slice/median_radix];
+						if(last <= row_base || last - 1 + radius < row_base + x){
+							std::fill(counts, counts + median_radix, 0);
+							for(column_t xx = lo; xx < hi; ++xx){
+								const count_type* const column = &column_counts[(slice/median_radix*columns + xx - cx0)*median_radix];
+								for(std::size_t d = 0; d < median_radix; ++d){
+									counts[d] = static_cast<count_type>(counts[d] + column[d]);
+								}
+							}
+						}else{
+							for(column_t xx = static_cast<column_t>(last - row_base); xx <= x; ++xx){
+								if(xx + radius < width){
+									const count_type* const column = &column_counts[(slice/median_radix*columns + xx + radius - cx0)*median_radix];
+									for(std::size_t d = 0; d < median_radix; ++d){
+										counts[d] = static_cast<count_type>(counts[d] + column[d]);
+									}
+								}
+								if(radius < xx){
+									const count_type* const column = &column_counts[(slice/median_radix*columns + xx - radius - 1 - cx0)*median_radix];
+									for(std::size_t d = 0; d < median_radix; ++d){
+										counts[d] = static_cast<count_type>(counts[d] - column[d]);
+									}
+								}
+							}
+						}
+						last = row_base + x + 1;
+						std::size_t d = 0;
+						for(; accumulated + counts[d] <= rank; ++d){
+							accumulated += counts[d];
+						}
+						prefix = prefix*median_radix + d;
+					}
+					dst[(static_cast<std::size_t>(y)*width + x)*3 + channel] = static_cast<value_type>(prefix);
+				}
+			}
+
+			// 次の短冊のために列ヒストグラムを空に戻す。
+			for(row_t y = limit_h < radius + 1 ? 0 : limit_h - radius - 1; y < std::min(limit_h + radius, height); ++y){
+				for(column_t x = cx0; x < cx1; ++x){
+					median_count(&column_counts[0], columns, x - cx0, offsets, src[(static_cast<std::size_t>(y)*width + x)*3 + channel], -1);
+				}
+			}
+		}
+	}
+	return image;
+}
+
+Image& Crop::process(Image& image)const
+{
+	if(!within(image)){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Crop process. invalid area specification."));
+	}
+
+	const column_t limit_w = area_.offset_x_ + area_.width_;
+	const row_t limit_h = area_.offset_y_ + area_.height_;
+	Image result = Image(area_.width_, area_.height_);
+	for(row_t h = area_.offset_y_, i = 0; h < limit_h; ++h, ++i){
+		for(column_t w = area_.offset_x_, j = 0; w < limit_w; ++w, ++j){
+			result[i][j] = image[h][w];
+		}
+	}
+	return image.swap(result);
+}
+
+/**
+ * 小さな分母の有理数だけで構成されるカーネル(Sobel, Laplacian, WeightedSmoothing 等)は
+ * 整数の重みと共通の分母に変換しておき、int の積和で固定小数点演算する。
+ * 重みの絶対値の総和は 65535 倍しても int に収まる範囲に制限する。
+ */
+Filter::Filter(const Kernel& kernel, Border border, const Pixel<>& constant):
+	kernel_(kernel), row_(), column_(), weights_(), row_weights_(), column_weights_(), divisor_(0),
+	border_(border), constant_(constant)
+{
+	if(kernel_.empty() || kernel_[0].empty()){
+		return;
+	}
+	for(std::size_t i = 0; i < kernel_.size(); ++i){
+		if(kernel_[i].size() != kernel_[0].size()){
+			return;
+		}
+	}
+	rank_one(kernel_, column_, row_);
+	rationalize();
+}
+
+Filter::Filter(const KernelRow& row, const KernelRow& column, Border border, const Pixel<>& constant):
+	kernel_(column.size(), KernelRow(row.size())), row_(row), column_(column),
+	weights_(), row_weights_(), column_weights_(), divisor_(0), border_(border), constant_(constant)
+{
+	for(std::size_t i = 0; i < column.size(); ++i){
+		for(std::size_t j = 0; j < row.size(); ++j){
+			kernel_[i][j] = column[i]*row[j];
+		}
+	}
+	if(!row.empty() && !column.empty()){
+		rationalize();
+	}
+}
+
+Filter::~Filter(){}
+
+void Filter::rationalize()
+{
+	const int max_divisor = 4096;
+	const int max_weight_sum = 32767;
+	for(int divisor = 1; divisor <= max_divisor; ++divisor){
+		std::vector<int> weights;
+		int weight_sum = 0;
+		bool rational = true;
+		for(std::size_t i = 0; rational && i < kernel_.size(); ++i){
+			for(std::size_t j = 0; rational && j < kernel_[i].size(); ++j){
+				const double scaled  = kernel_[i][j]*divisor;
+				const double rounded = std::floor(scaled + 0.5);
+				if(1.0e-9 < std::fabs(scaled - rounded) || max_weight_sum < weight_sum + std::fabs(rounded)){
+					rational = false;
+				}else{
+					weights.push_back(static_cast<int>(rounded));
+					weight_sum += std::abs(weights.back());
+				}
+			}
+		}
+		if(rational){
+			weights_.swap(weights);
+			divisor_ = divisor;
+			rank_one(weights_, kernel_[0].size(), column_weights_, row_weights_);
+			return;
+		}
+	}
+}
+
+Image& Filter::process(Image& image)const
+{
+	if(!(kernel_.size() % 2) || kernel_.size() < 2){
+		throw std::runtime_error(__func__ + std::string(": can not apply filter. filter kernel height must be odd number more than 1."));
+	}
+	const std::size_t kernel_width = kernel_[0].size();
+	for(std::size_t i = 0; i < kernel_.size(); ++i){
+		if(!(kernel_[i].size() % 2) || kernel_[i].size() < 2 || kernel_[i].size() != kernel_width){
+			throw std::runtime_error(__func__ + std::string(": can not apply filter. filter kernel width must be odd number more than 1."));
+		}
+	}
+	if(separable()){
+		return process_separable(image);
+	}
+	if(filter_fft_taps <= kernel_.size()*kernel_width){
+		return process_fft(image);
+	}
+
+	Image result = Image(image.width(), image.height());
+	if(divisor_){
+		convolve(image, result, weights_, kernel_width, 1.0/divisor_, border_, constant_);
+	}else{
+		std::vector<double> weights;
+		for(std::size_t i = 0; i < kernel_.size(); ++i){
+			weights.insert(weights.end(), kernel_[i].begin(), kernel_[i].end());
+		}
+		convolve(image, result, weights, kernel_width, 1.0, border_, constant_);
+	}
+	return image.swap(result);
+}
+
+Image& Filter::process_separable(Image& image)const
+{
+	Image result = Image(image.width(), image.height());
+	if(divisor_ && !row_weights_.empty()){
+		convolve_separable(image, result, row_weights_, column_weights_, 1.0/divisor_, border_, constant_);
+	}else{
+		convolve_separable(image, result, row_, column_, 1.0, border_, constant_);
+	}
+	return image.swap(result);
+}
+
+/**
+ * タイルを画像の外は border で補って N x N に切り出し、カーネルのスペクトルを掛けて戻した巡回畳み込みのうち、
+ * 折り返しの影響を受けない (N - K + 1) 四方だけを使う(overlap-save)。実数の画素値は 2 面ずつ
+ * 実部と虚部に詰めて 1 回の複素変換で済ませ、横に並んだ 2 タイルの 6 面を 1 つの仕事にして
+ * スレッドに割り振る。整数の重みを持つカーネルは和を整数に丸めてから分母で割るので、
+ * 固定小数点の積和と同じ結果になる。
+ */
+Image& Filter::process_fft(Image& image)const
+{
+	typedef FFT::complex_type complex_type;
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t kernel_height = kernel_.size(), kernel_width = kernel_[0].size();
+	const row_t    radius_h = static_cast<row_t>(kernel_height/2);
+	const column_t radius_w = static_cast<column_t>(kernel_width/2);
+	const double scale = divisor_ ? 1.0/divisor_ : 1.0;
+	std::vector<double> weights(kernel_height*kernel_width);
+	for(std::size_t i = 0; i < kernel_height; ++i){
+		for(std::size_t j = 0; j < kernel_width; ++j){
+			weights[i*kernel_width + j] = divisor_ ? weights_[i*kernel_width + j] : kernel_[i][j];
+		}
+	}
+
+	std::size_t size = filter_fft_min;
+	double cost = 0.0;
+	for(std::size_t n = filter_fft_min; n <= filter_fft_max || !(0.0 < cost); n *= 2){
+		if(n < std::max(kernel_height, kernel_width)*2){
+			continue;
+		}
+		const std::size_t tiles = (height + n - kernel_height)/(n - kernel_height + 1)*((width + n - kernel_width)/(n - kernel_width + 1));
+		const double c = static_cast<double>(tiles*n*n)*std::log(static_cast<double>(n));
+		if(!(0.0 < cost) || c < cost){
+			size = n;
+			cost = c;
+		}
+	}
+	const FFT fft(size);
+	const row_t    block_h = static_cast<row_t>(size - kernel_height + 1);
+	const column_t block_w = static_cast<column_t>(size - kernel_width + 1);
+	const row_t    tiles_y = (height + block_h - 1)/block_h;
+	const column_t tiles_x = (width + block_w - 1)/block_w;
+	const column_t pairs_x = (tiles_x + 1)/2;
+
+	// 出力 n が入力 n - radius + i を重み kernel[i] で集めるように、カーネルを反転して置く。
+	std::vector<complex_type> spectrum(size*size);
+	const double normalize = 1.0/static_cast<double>(size*size);
+	for(std::size_t i = 0; i < kernel_height; ++i){
+		for(std::size_t j = 0; j < kernel_width; ++j){
+			spectrum[(size + radius_h - i)%size*size + (size + radius_w - j)%size] = weights[i*kernel_width + j]*normalize;
+		}
+	}
+	{
+		std::vector<complex_type> work;
+		fft.transform2d(&spectrum[0], work);
+	}
+
+	Image result = Image(width, height);
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&result[0][0]);
+	const double fill[] = {static_cast<double>(constant_.R()), static_cast<double>(constant_.G()), static_cast<double>(constant_.B())};
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+#pragma omp parallel if(large)
+	{
+		std::vector<complex_type> buffer(size*size), work;
+		std::vector<std::ptrdiff_t> rows_map(size), columns_map(size);
+#pragma omp for schedule(dynamic)
+		for(column_t task = 0; task < tiles_y*pairs_x; ++task){
+			const row_t y0 = task/pairs_x*block_h;
+			const column_t first = task%pairs_x*2;
+			const std::size_t planes = std::min(tiles_x - first, 2u)*3;
+			const row_t rows = std::min(block_h, height - y0);
+			for(std::size_t y = 0; y < size; ++y){
+				rows_map[y] = border_index(static_cast<std::ptrdiff_t>(y0 + y) - radius_h, static_cast<std::ptrdiff_t>(height), border_);
+			}
+			for(std::size_t plane = 0; plane < planes; plane += 2){
+				for(std::size_t k = 0; k < 2; ++k){
+					if(planes <= plane + k){
+						for(std::size_t i = 0; i < buffer.size(); ++i){
+							buffer[i] = complex_type(buffer[i].real(), 0.0);
+						}
+						continue;
+					}
+					const column_t x0 = (first + static_cast<column_t>((plane + k)/3))*block_w;
+					const std::size_t channel = (plane + k)%3;
+					for(std::size_t x = 0; x < size; ++x){
+						columns_map[x] = border_index(static_cast<std::ptrdiff_t>(x0 + x) - radius_w, static_cast<std::ptrdiff_t>(width), border_);
+					}
+					for(std::size_t y = 0; y < size; ++y){
+						complex_type* const line = &buffer[y*size];
+						const std::ptrdiff_t row = rows_map[y]*static_cast<std::ptrdiff_t>(width);
+						for(std::size_t x = 0; x < size; ++x){
+							const double v = rows_map[y] < 0 || columns_map[x] < 0 ? fill[channel] : src[(row + columns_map[x])*3 + static_cast<std::ptrdiff_t>(channel)];
+							line[x] = k ? complex_type(line[x].real(), v) : complex_type(v, 0.0);
+						}
+					}
+				}
+				fft.transform2d(&buffer[0], work);
+				for(std::size_t i = 0; i < buffer.size(); ++i){
+					const double ar = buffer[i].real(), ai = buffer[i].imag();
+					const double br = spectrum[i].real(), bi = spectrum[i].imag();
+					buffer[i] = complex_type(ar*br - ai*bi, ar*bi + ai*br);
+				}
+				fft.transform2d(&buffer[0], work, true);
+				for(std::size_t k = 0; k < 2 && plane + k < planes; ++k){
+					const column_t x0 = (first + static_cast<column_t>((plane + k)/3))*block_w;
+					const std::size_t channel = (plane + k)%3;
+					const column_t columns = std::min(block_w, width - x0);
+					for(row_t y = 0; y < rows; ++y){
+						const complex_type* const in = &buffer[(y + radius_h)*size + radius_w];
+						value_type* const out = dst + ((static_cast<std::size_t>(y0 + y))*width + x0)*3 + channel;
+						for(column_t x = 0; x < columns; ++x){
+							const double v = k ? in[x].imag() : in[x].real();
+							out[x*3] = saturate((divisor_ ? std::floor(v + 0.5) : v)*scale);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return image.swap(result);
+}
+
+Filter::Kernel WeightedSmoothing::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back(0/13.0);
+	kernel[0].push_back(0/13.0);
+	kernel[0].push_back(1/13.0);
+	kernel[0].push_back(0/13.0);
+	kernel[0].push_back(0/13.0);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back(0/13.0);
+	kernel[1].push_back(1/13.0);
+	kernel[1].push_back(1/13.0);
+	kernel[1].push_back(1/13.0);
+	kernel[1].push_back(0/13.0);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back(1/13.0);
+	kernel[2].push_back(1/13.0);
+	kernel[2].push_back(1/13.0);
+	kernel[2].push_back(1/13.0);
+	kernel[2].push_back(1/13.0);
+	kernel.push_back(KernelRow());
+	kernel[3].push_back(0/13.0);
+	kernel[3].push_back(1/13.0);
+	kernel[3].push_back(1/13.0);
+	kernel[3].push_back(1/13.0);
+	kernel[3].push_back(0/13.0);
+	kernel.push_back(KernelRow());
+	kernel[4].push_back(0/13.0);
+	kernel[4].push_back(0/13.0);
+	kernel[4].push_back(1/13.0);
+	kernel[4].push_back(0/13.0);
+	kernel[4].push_back(0/13.0);
+	return kernel;
+}
+
+Filter::Kernel UnSharpMask::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back( 0);
+	kernel[0].push_back(-1);
+	kernel[0].push_back( 0);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back(-1);
+	kernel[1].push_back( 5);
+	kernel[1].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back( 0);
+	kernel[2].push_back(-1);
+	kernel[2].push_back( 0);
+	return kernel;
+}
+
+Filter::Kernel Prewitt::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back( 0);
+	kernel[1].push_back( 0);
+	kernel[1].push_back( 0);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back( 1);
+	kernel[2].push_back( 1);
+	kernel[2].push_back( 1);
+	return kernel;
+}
+
+Filter::Kernel Sobel::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-2);
+	kernel[0].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back( 0);
+	kernel[1].push_back( 0);
+	kernel[1].push_back( 0);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back( 1);
+	kernel[2].push_back( 2);
+	kernel[2].push_back( 1);
+	return kernel;
+}
+
+Filter::Kernel Laplacian3x3::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back(-1);
+	kernel[1].push_back( 8);
+	kernel[1].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back(-1);
+	kernel[2].push_back(-1);
+	kernel[2].push_back(-1);
+	return kernel;
+}
+
+Filter::Kernel Laplacian5x5::init()
+{
+	Kernel kernel;
+	kernel.push_back(KernelRow());
+	kernel[0].push_back(-1);
+	kernel[0].push_back(-3);
+	kernel[0].push_back(-4);
+	kernel[0].push_back(-3);
+	kernel[0].push_back(-1);
+	kernel.push_back(KernelRow());
+	kernel[1].push_back(-3);
+	kernel[1].push_back( 0);
+	kernel[1].push_back( 6);
+	kernel[1].push_back( 0);
+	kernel[1].push_back(-3);
+	kernel.push_back(KernelRow());
+	kernel[2].push_back(-4);
+	kernel[2].push_back( 6);
+	kernel[2].push_back(20);
+	kernel[2].push_back( 6);
+	kernel[2].push_back(-4);
+	kernel.push_back(KernelRow());
+	kernel[3].push_back(-3);
+	kernel[3].push_back( 0);
+	kernel[3].push_back( 6);
+	kernel[3].push_back( 0);
+	kernel[3].push_back(-3);
+	kernel.push_back(KernelRow());
+	kernel[4].push_back(-1);
+	kernel[4].push_back(-3);
+	kernel[4].push_back(-4);
+	kernel[4].push_back(-3);
+	kernel[4].push_back(-1);
+	return kernel;
 }
 
-Image& Tone::process(Image& image)const
+/**
+ * 係数は Young, van Vliet (1995) の q の多項式による。ただし論文の q と sigma の近似式では前後 2 回の
+ * インパルス応答の分散が sigma^2 より 2 割ほど大きくなるので、q は分散がちょうど sigma^2 になるように
+ * 二分法で決める。1 回分の分散は分母の多項式 P(s) = 1 - a0 s - a1 s^2 - a2 s^3 の s = 1 での微分から求まる。
+ * 後ろ向きの初期値を決める m は、前向きの最後の 3 段の定常値からのずれを 1 つずつ 1 にして、
+ * 入力が定常値のまま続くとして前向き・後ろ向きを収束するまで回した結果の先頭 3 段を並べたもの
+ * (Triggs, Sdika 2006 の行列を数値的に求めたもの)。
+ */
+GaussianBlur::GaussianBlur(double sigma): sigma_(sigma), b_(), a_(), m_()
 {
-	if(!within(image)){
-		throw std::invalid_argument(__func__ + std::string(": can not apply Tone process. invalid area specification."));
+	if(!(0.5 <= sigma_)){
+		throw std::invalid_argument(__func__ + std::string(": can not create gaussian blur. sigma must be 0.5 or more."));
+	}
+	double lower = 0.0, upper = sigma_*2.0 + 1.0;
+	for(int iteration = 0; iteration < 64; ++iteration){
+		const double q = (lower + upper)/2.0;
+		const double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+		a_[0] = (2.44413*q + 2.85619*q*q + 1.26661*q*q*q)/b0;
+		a_[1] = -(1.4281*q*q + 1.26661*q*q*q)/b0;
+		a_[2] = 0.422205*q*q*q/b0;
+		b_ = 1.0 - (a_[0] + a_[1] + a_[2]);
+		const double d1 = -(a_[0] + a_[1]*2.0 + a_[2]*3.0), d2 = -(a_[1]*2.0 + a_[2]*6.0);
+		const double mean = -d1/b_;
+		const double variance = (d1*d1*2.0/b_ - d2)/b_ + mean - mean*mean;
+		(variance*2.0 < sigma_*sigma_ ? lower : upper) = q;
 	}
 
-	const column_t limit_w =
-		area_.width_  == 0 && area_.offset_x_ == 0
-						? image.width()  : area_.offset_x_ + area_.width_;
-	const row_t    limit_h =
-		area_.height_ == 0 && area_.offset_y_ == 0
-						? image.height() : area_.offset_y_ + area_.height_;
+	for(std::size_t k = 0; k < 3; ++k){
+		std::vector<double> u(3, 0.0);
+		u[2 - k] = 1.0;
+		for(std::size_t n = 3; n < 6 || 1.0e-15 < std::fabs(u[n - 1]) + std::fabs(u[n - 2]) + std::fabs(u[n - 3]); ++n){
+			u.push_back(a_[0]*u[n - 1] + a_[1]*u[n - 2] + a_[2]*u[n - 3]);
+		}
+		std::vector<double> y(u.size() + 3, 0.0);
+		for(std::size_t n = u.size() - 1; 3 <= n; --n){
+			y[n] = b_*u[n] + a_[0]*y[n + 1] + a_[1]*y[n + 2] + a_[2]*y[n + 3];
+		}
+		for(std::size_t j = 0; j < 3; ++j){
+			m_[j][k] = y[j + 3];
+		}
+	}
+}
 
-	for(row_t h = area_.offset_y_; h < limit_h; ++h){
-		for(column_t w = area_.offset_x_; w < limit_w; ++w){
-			converter_.convert(image[h][w]);
+/**
+ * 縦方向の処理で一度 16bit に丸めてから横方向に掛けるので、バッファは短冊と行の束の分だけで済む。
+ */
+Image& GaussianBlur::process(Image& image)const
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	value_type* const pixels = reinterpret_cast<value_type*>(&image[0][0]);
+	const column_t strips = (width + gaussian_strip - 1)/gaussian_strip;
+	const row_t    blocks = (height + gaussian_rows - 1)/gaussian_rows;
+	const std::size_t stride = width*3;
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel if(large)
+	{
+		std::vector<double> buffer(std::max((height + 6)*gaussian_strip, (width + 6)*gaussian_rows)*3);
+#pragma omp for schedule(dynamic)
+		for(column_t strip = 0; strip < strips; ++strip){
+			const std::size_t x0 = static_cast<std::size_t>(strip)*gaussian_strip*3;
+			const std::size_t lanes = std::min(gaussian_strip, width - strip*gaussian_strip)*3;
+			for(row_t h = 0; h < height; ++h){
+				std::copy(pixels + h*stride + x0, pixels + h*stride + x0 + lanes, &buffer[(h + 3)*lanes]);
+			}
+			gaussian_recursion(&buffer[0], height, lanes, b_, a_, m_);
+			for(row_t h = 0; h < height; ++h){
+				for(std::size_t l = 0; l < lanes; ++l){
+					pixels[h*stride + x0 + l] = saturate(buffer[(h + 3)*lanes + l]);
+				}
+			}
+		}
+#pragma omp for schedule(dynamic)
+		for(row_t block = 0; block < blocks; ++block){
+			const row_t h0 = block*gaussian_rows;
+			const std::size_t rows = std::min(gaussian_rows, height - h0);
+			const std::size_t lanes = rows*3;
+			for(std::size_t r = 0; r < rows; ++r){
+				const value_type* const src = pixels + (h0 + r)*stride;
+				for(column_t w = 0; w < width; ++w){
+					for(std::size_t c = 0; c < 3; ++c){
+						buffer[(w + 3)*lanes + r*3 + c] = src[w*3 + c];
+					}
+				}
+			}
+			gaussian_recursion(&buffer[0], width, lanes, b_, a_, m_);
+			for(std::size_t r = 0; r < rows; ++r){
+				value_type* const dst = pixels + (h0 + r)*stride;
+				for(column_t w = 0; w < width; ++w){
+					for(std::size_t c = 0; c < 3; ++c){
+						dst[w*3 + c] = saturate(buffer[(w + 3)*lanes + r*3 + c]);
+					}
+				}
+			}
 		}
 	}
 	return image;
 }
 
-Image& Normalize::process(Image& image)const
+BoxBlur::BoxBlur(column_t width, row_t height, Filter::Border border, const Pixel<>& constant):
+	width_(width), height_(height), border_(border), constant_(constant)
 {
-	if(!within(image)){
-		throw std::invalid_argument(__func__ + std::string(": can not apply Normalize process. invalid area specification."));
+	if(!(width_ % 2) || !(height_ % 2)){
+		throw std::invalid_argument(__func__ + std::string(": can not create box blur. window size must be odd number."));
 	}
+}
 
-	const column_t limit_w =
-		area_.width_  == 0 && area_.offset_x_ == 0
-						? image.width()  : area_.offset_x_ + area_.width_;
-	const row_t    limit_h =
-		area_.height_ == 0 && area_.offset_y_ == 0
-						? image.height() : area_.offset_y_ + area_.height_;
+/**
+ * 窓の和が 32bit に収まるうちは 32bit で数える(ベクトル化したときのレーン数が倍になる)。
+ * 収まらなければ std::size_t で数える。
+ */
+Image& BoxBlur::process(Image& image)const
+{
+	Image result = Image(image.width(), image.height());
+	if(static_cast<double>(width_)*height_*Image::pixel_type::max <= static_cast<double>(std::numeric_limits<uint32_t>::max())){
+		box_sum<uint32_t>(image, result, width_, height_, border_, constant_);
+	}else{
+		box_sum<std::size_t>(image, result, width_, height_, border_, constant_);
+	}
+	return image.swap(result);
+}
 
-	const Image::pixel_type::value_type max = *std::max_element(
-		reinterpret_cast<Image::pixel_type::value_type*>(&image[0][0]),
-		reinterpret_cast<Image::pixel_type::value_type*>(&image[image.height()][0]));
+Morphology::Morphology(column_t width, row_t height): width_(width), height_(height)
+{
+	if(!width_ || !height_){
+		throw std::invalid_argument(__func__ + std::string(": can not create morphology. structuring element must not be empty."));
+	}
+}
 
-	for(row_t h = area_.offset_y_; h < limit_h; ++h){
-		for(column_t w = area_.offset_x_; w < limit_w; ++w){
-			image[h][w] = Pixel<double>(image[h][w]) / static_cast<double>(max) * Image::pixel_type::max;
+/**
+ * 収縮は基準点からの位置 b の画素の最小、膨張は -b の画素の最大なので、膨張では窓の前後を入れ替える。
+ * こうしておくと偶数の大きさでも Open が冪等になる。
+ */
+Image& Morphology::erode(Image& image)const
+{
+	morphology<Minimum>(image, width_, height_, width_/2, height_/2, Image::pixel_type::max);
+	return image;
+}
+
+Image& Morphology::dilate(Image& image)const
+{
+	morphology<Maximum>(image, width_, height_, width_ - 1 - width_/2, height_ - 1 - height_/2, 0);
+	return image;
+}
+
+Image& Erode::process(Image& image)const
+{
+	return erode(image);
+}
+
+Image& Dilate::process(Image& image)const
+{
+	return dilate(image);
+}
+
+Image& Open::process(Image& image)const
+{
+	return dilate(erode(image));
+}
+
+Image& Close::process(Image& image)const
+{
+	return erode(dilate(image));
+}
+
+Image& TopHat::process(Image& image)const
+{
+	Image opened(image);
+	dilate(erode(opened));
+	value_type* const first = reinterpret_cast<value_type*>(&image[0][0]);
+	const value_type* const second = reinterpret_cast<const value_type*>(&opened[0][0]);
+	const std::size_t size = static_cast<std::size_t>(image.width())*image.height()*3;
+	const bool large = tone_parallel_pixels <= size/3;
+#pragma omp parallel for schedule(static) if(large)
+	for(std::size_t i = 0; i < size; ++i){
+		first[i] = static_cast<value_type>(first[i] - second[i]);
+	}
+	return image;
+}
+
+Gradient& Gradient::operator=(const Gradient& gradient)
+{
+	operator_ = gradient.operator_;
+	norm_ = gradient.norm_;
+	orientation_ = gradient.orientation_;
+	border_ = gradient.border_;
+	return *this;
+}
+
+/**
+ * 左右に 1 画素延ばした 3 行を輪状に持ち、1 行ごとに微分を整数で求める。行は帯に分けてスレッドに割り振る。
+ */
+Image& Gradient::process(Image& image)const
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t lanes = width*3u, padded = (width + 2u)*3u;
+	const row_t bands = (height + filter_band - 1)/filter_band;
+	if(orientation_){
+		orientation_->resize(static_cast<std::size_t>(width)*height);
+	}
+	Image result(width, height);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+#pragma omp parallel if(large)
+	{
+		std::vector<value_type> cache(padded*3);
+		std::vector<int> gx(lanes), gy(lanes);
+		const value_type* rows[3];
+#pragma omp for schedule(static)
+		for(row_t band = 0; band < bands; ++band){
+			const row_t first = band*filter_band;
+			const row_t last  = std::min(first + filter_band, height);
+			for(std::ptrdiff_t r = static_cast<std::ptrdiff_t>(first) - 1; r < static_cast<std::ptrdiff_t>(first) + 1; ++r){
+				pad_row(image, r, 1, border_, black, &cache[static_cast<std::size_t>(r + 3)%3*padded]);
+			}
+			for(row_t h = first; h < last; ++h){
+				pad_row(image, static_cast<std::ptrdiff_t>(h) + 1, 1, border_, black, &cache[(h + 1)%3*padded]);
+				for(std::size_t i = 0; i < 3; ++i){
+					rows[i] = &cache[(h + 2 + i)%3*padded];
+				}
+				value_type* const dst = reinterpret_cast<value_type*>(&result[h][0]);
+				if(operator_ == OPERATOR_PREWITT){
+					gradient_row<1>(rows, lanes, &gx[0], &gy[0]);
+					gradient_magnitude<3>(&gx[0], &gy[0], lanes, norm_, dst);
+				}else{
+					gradient_row<2>(rows, lanes, &gx[0], &gy[0]);
+					gradient_magnitude<4>(&gx[0], &gy[0], lanes, norm_, dst);
+				}
+				if(orientation_){
+					gradient_orientation(&gx[0], &gy[0], width, &(*orientation_)[static_cast<std::size_t>(h)*width]);
+				}
+			}
+		}
+	}
+	return image.swap(result);
+}
+
+Bilateral::Bilateral(double sigma_s, double sigma_r): sigma_s_(sigma_s), sigma_r_(sigma_r)
+{
+	if(!(1.0 <= sigma_s_) || !(1.0 <= sigma_r_)){
+		throw std::invalid_argument(__func__ + std::string(": can not create bilateral filter. sigma must be 1 or more."));
+	}
+}
+
+/**
+ * splat は格子の行ごとにスレッドに割り振る。最も近い格子の行が同じ画素の行は 1 つのスレッドだけが足し込むので競合しない。
+ * ぼかしは [1 2 1]/4 を 2 回掛けて [1 4 6 4 1]/16 にする。値の軸と横の軸は格子の行ごと、縦の軸は行の中の要素ごとに分ける。
+ */
+Image& Bilateral::process(Image& image)const
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t lanes = width*3u;
+	const value_type* const first = reinterpret_cast<const value_type*>(&image[0][0]);
+	const value_type* const last = first + lanes*height;
+	const value_type minimum = *std::min_element(first, last);
+	const double range = *std::max_element(first, last) - minimum;
+	const std::size_t pad = bilateral_padding, cell = bilateral_cell;
+	const std::size_t gx = static_cast<std::size_t>((width - 1)/sigma_s_ + 0.5) + 1 + pad*2;
+	const std::size_t gy = static_cast<std::size_t>((height - 1)/sigma_s_ + 0.5) + 1 + pad*2;
+	const std::size_t gz = static_cast<std::size_t>(range/sigma_r_ + 0.5) + 1 + pad*2;
+	const std::size_t line = gz*cell, slice = gx*line;
+	std::vector<float> grid(gy*slice, 0.0f);
+	const double inverse_s = 1.0/sigma_s_, inverse_r = 1.0/sigma_r_;
+
+	// 最も近い格子の行が j + pad になる画素の行は [rows[j], rows[j + 1])。
+	std::vector<row_t> rows(gy + 1, height);
+	for(row_t h = height; h--;){
+		rows[static_cast<std::size_t>(h*inverse_s + 0.5)] = h;
+	}
+	for(std::size_t j = gy; j--;){
+		rows[j] = std::min(rows[j], rows[j + 1]);
+	}
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+#pragma omp parallel if(large)
+	{
+		std::vector<float> previous(std::max(slice, line)), current(std::max(slice, line));
+#pragma omp for schedule(dynamic)
+		for(std::size_t j = 0; j < gy - pad*2; ++j){
+			float* const plane = &grid[(j + pad)*slice];
+			for(row_t h = rows[j]; h < rows[j + 1]; ++h){
+				const value_type* const src = reinterpret_cast<const value_type*>(&image[h][0]);
+				for(column_t w = 0; w < width; ++w){
+					float* const column = plane + (static_cast<std::size_t>(w*inverse_s + 0.5) + pad)*line;
+					for(std::size_t c = 0; c < 3; ++c){
+						const value_type v = src[w*3 + c];
+						float* const p = column + (static_cast<std::size_t>((v - minimum)*inverse_r + 0.5) + pad)*cell + c*2;
+						p[0] += v;
+						p[1] += 1.0f;
+					}
+				}
+			}
+		}
+#pragma omp for schedule(dynamic)
+		for(std::size_t y = pad; y < gy - pad; ++y){
+			for(int pass = 0; pass < 2; ++pass){
+				for(std::size_t x = 0; x < gx; ++x){
+					grid_blur(&grid[y*slice + x*line], gz, cell, cell, &previous[0], &current[0]);
+				}
+				grid_blur(&grid[y*slice], gx, line, line, &previous[0], &current[0]);
+			}
+		}
+		// 縦の軸は格子の行の中の要素を line 個ずつに分けて割り振る。
+#pragma omp for schedule(dynamic)
+		for(std::size_t x = 0; x < gx; ++x){
+			for(int pass = 0; pass < 2; ++pass){
+				grid_blur(&grid[x*line], gy, slice, line, &previous[0], &current[0]);
+			}
+		}
+#pragma omp for schedule(static)
+		for(row_t h = 0; h < height; ++h){
+			const double fy = h*inverse_s + static_cast<double>(pad);
+			const std::size_t y0 = static_cast<std::size_t>(fy);
+			const float ty = static_cast<float>(fy - static_cast<double>(y0));
+			value_type* const dst = reinterpret_cast<value_type*>(&image[h][0]);
+			for(column_t w = 0; w < width; ++w){
+				const double fx = w*inverse_s + static_cast<double>(pad);
+				const std::size_t x0 = static_cast<std::size_t>(fx);
+				const float tx = static_cast<float>(fx - static_cast<double>(x0));
+				const float* const p00 = &grid[y0*slice + x0*line];
+				const float* const p01 = p00 + line;
+				const float* const p10 = p00 + slice;
+				const float* const p11 = p10 + line;
+				for(std::size_t c = 0; c < 3; ++c){
+					const double fz = (dst[w*3 + c] - minimum)*inverse_r + static_cast<double>(pad);
+					const std::size_t z0 = static_cast<std::size_t>(fz);
+					const float tz = static_cast<float>(fz - static_cast<double>(z0));
+					const std::size_t k = z0*cell + c*2;
+					float sum[2];
+					for(std::size_t i = 0; i < 2; ++i){
+						const float a = (p00[k + i]*(1.0f - tz) + p00[k + cell + i]*tz)*(1.0f - tx) + (p01[k + i]*(1.0f - tz) + p01[k + cell + i]*tz)*tx;
+						const float b = (p10[k + i]*(1.0f - tz) + p10[k + cell + i]*tz)*(1.0f - tx) + (p11[k + i]*(1.0f - tz) + p11[k + cell + i]*tz)*tx;
+						sum[i] = a*(1.0f - ty) + b*ty;
+					}
+					dst[w*3 + c] = saturate(static_cast<double>(sum[0])/static_cast<double>(sum[1]));
+				}
+			}
 		}
 	}
 	return image;
 }
 
-Image& Median::process(Image& image)const
+/**
+ * 係数表は出力の列ごとに 1 度だけ作り、全ての行で使い回す。行は互いに独立なのでスレッドに割り振る。
+ */
+Image& HScale::process(Image& image)const
 {
-	if(!within(image)){
-		throw std::invalid_argument(__func__ + std::string(": can not apply Median filter. invalid area specification."));
+	const ResamplingTable table(image.width(), width_, interpolation_);
+	const row_t height = image.height();
+	Image result(width_, height);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width_)*height;
+#pragma omp parallel for schedule(static) if(large)
+	for(row_t h = 0; h < height; ++h){
+		resample_row(reinterpret_cast<const value_type*>(&image[h][0]), reinterpret_cast<value_type*>(&result[h][0]), table, width_);
 	}
+	return image.swap(result);
+}
 
-	const column_t limit_w =
-		area_.width_  == 0 && area_.offset_x_ == 0
-						? image.width()  : area_.offset_x_ + area_.width_;
-	const row_t limit_h =
-		area_.height_ == 0 && area_.offset_y_ == 0
-						? image.height() : area_.offset_y_ + area_.height_;
+/**
+ * 出力の 1 行ごとに係数の掛かる入力行を足し合わせるので、画像は行の順に読む。
+ */
+Image& VScale::process(Image& image)const
+{
+	const ResamplingTable table(image.height(), height_, interpolation_);
+	const std::size_t taps = table.taps(), lanes = image.width()*3;
+	Image result(image.width(), height_);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(image.width())*height_;
+#pragma omp parallel if(large)
+	{
+		std::vector<const value_type*> rows(taps);
+		std::vector<int> accumulator(lanes);
+#pragma omp for schedule(static)
+		for(row_t h = 0; h < height_; ++h){
+			for(std::size_t k = 0; k < taps; ++k){
+				rows[k] = reinterpret_cast<const value_type*>(&image[static_cast<row_t>(table.first(h) + k)][0]);
+			}
+			resample_rows(&rows[0], table.coefficients(h), taps, reinterpret_cast<value_type*>(&result[h][0]), lanes, &accumulator[0]);
+		}
+	}
+	return image.swap(result);
+}
 
-	Image result = Image(image.width(), image.height());
+Image& Resize::process(Image& image)const
+{
+	const ResamplingTable columns(image.width(), width_, interpolation_), rows(image.height(), height_, interpolation_);
+	const row_t bands = (height_ + resize_band - 1)/resize_band;
+	Image result(width_, height_);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width_)*height_;
+#pragma omp parallel if(large)
+	{
+		ResizeRows resize(image, columns, rows, width_);
+#pragma omp for schedule(static)
+		for(row_t band = 0; band < bands; ++band){
+			const row_t last = std::min(band*resize_band + resize_band, height_);
+			for(row_t h = band*resize_band; h < last; ++h){
+				resize(h, reinterpret_cast<value_type*>(&result[h][0]));
+			}
+		}
+	}
+	return image.swap(result);
+}
 
-	for(row_t h = area_.offset_y_; h < limit_h; ++h){
-		const row_t h_lowerbound = h - 1 < image.height() ? h - 1 : 0 ;
-		const row_t h_upperbound = std::min(h + 1, image.height());
-		for(column_t w = area_.offset_x_; w < limit_w; ++w){
-			const column_t w_lowerbound = w - 1 < image.width() ? w - 1 : 0 ;
-			const column_t w_upperbound = std::min(w + 1, image.width());
-			std::vector<Image::pixel_type::value_type> values1;
-			std::vector<Image::pixel_type::value_type> values2;
-			std::vector<Image::pixel_type::value_type> values3;
-			for(row_t i = h_lowerbound; i < h_upperbound; ++i){
-				for(column_t j = w_lowerbound; j < w_upperbound; ++j){
-					values1.push_back(image[i][j].R());
-					values2.push_back(image[i][j].G());
-					values3.push_back(image[i][j].B());
-				}
-			}
-			std::sort(values1.begin(), values1.end());
-			std::sort(values2.begin(), values2.end());
-			std::sort(values3.begin(), values3.end());
-			result[h][w] = Image::pixel_type(
-					values1[values1.size()/2],
-					values2[values2.size()/2],
-					values3[values3.size()/2]);
+void Resize::stream(const Image& image, Sink& sink)const
+{
+	const ResamplingTable columns(image.width(), width_, interpolation_), rows(image.height(), height_, interpolation_);
+	ResizeRows resize(image, columns, rows, width_);
+	std::vector<value_type> buffer(width_*3u);
+	for(row_t h = 0; h < height_; ++h){
+		resize(h, &buffer[0]);
+		sink.write(h, Row(reinterpret_cast<byte_t*>(&buffer[0]), width_));
+	}
+}
+
+Warp::Warp(const Matrix& matrix, Scale::Interpolation interpolation, const Pixel<>& background):
+	inverse_(), interpolation_(interpolation), background_(background)
+{
+	if(interpolation_ != Scale::INTERPOLATION_NEAREST && interpolation_ != Scale::INTERPOLATION_BILINEAR && interpolation_ != Scale::INTERPOLATION_BICUBIC){
+		throw std::invalid_argument(__func__ + std::string(": can not create warp. interpolation must be nearest, bilinear or bicubic."));
+	}
+	if(!invert(matrix, inverse_)){
+		throw std::invalid_argument(__func__ + std::string(": can not create warp. matrix is singular."));
+	}
+}
+
+/**
+ * 8 元の連立一次方程式を部分ピボット選択の消去法で解き、m[2][2] を 1 とする。
+ * ピボットが係数の最大値の 1e-12 倍以下なら、3 点が同一直線上にあるとみなす。
+ */
+void Warp::homography(const double (*source)[2], const double (*destination)[2], Matrix& m)
+{
+	double a[8][9];
+	for(int i = 0; i < 4; ++i){
+		const double x = source[i][0], y = source[i][1], u = destination[i][0], v = destination[i][1];
+		const double first[9]  = {x, y, 1.0, 0.0, 0.0, 0.0, -u*x, -u*y, u};
+		const double second[9] = {0.0, 0.0, 0.0, x, y, 1.0, -v*x, -v*y, v};
+		std::copy(first, first + 9, a[i*2]);
+		std::copy(second, second + 9, a[i*2 + 1]);
+	}
+	double norm = 0.0;
+	for(int i = 0; i < 8; ++i){
+		for(int j = 0; j < 8; ++j){
+			norm = std::max(norm, std::fabs(a[i][j]));
+		}
+	}
+	for(int k = 0; k < 8; ++k){
+		int pivot = k;
+		for(int i = k; i < 8; ++i){
+			if(std::fabs(a[pivot][k]) < std::fabs(a[i][k])){
+				pivot = i;
+			}
+		}
+		if(!(1.0e-12*norm < std::fabs(a[pivot][k]))){
+			throw std::invalid_argument(__func__ + std::string(": can not create homography. points are degenerate."));
+		}
+		std::swap_ranges(a[k], a[k] + 9, a[pivot]);
+		for(int i = 0; i < 8; ++i){
+			if(i == k){
+				continue;
+			}
+			const double f = a[i][k]/a[k][k];
+			for(int j = k; j < 9; ++j){
+				a[i][j] -= f*a[k][j];
+			}
+		}
+	}
+	for(int i = 0; i < 8; ++i){
+		m[i/3][i%3] = a[i][8]/a[i][i];
+	}
+	m[2][2] = 1.0;
+}
+
+/**
+ * 出力の画素の中心を inverse_ で写した同次座標 (X, Y, Z) は、右に 1 画素進むごとに inverse_ の第 1 列だけ増える。
+ * タイルの行の先頭でだけ行列を掛け直すので、誤差はタイルの幅の分しか積もらない。Z が正でない位置は background。
+ */
+Image& Warp::process(Image& image)const
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const std::size_t tiles_x = (width + warp_tile - 1)/warp_tile, tiles_y = (height + warp_tile - 1)/warp_tile;
+	const std::size_t tiles = tiles_x*tiles_y;
+	const value_type background[3] = {background_.R(), background_.G(), background_.B()};
+	const double limit_u = static_cast<double>(width) + 2.0, limit_v = static_cast<double>(height) + 2.0;
+	Image result(width, height);
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+#pragma omp parallel for schedule(dynamic) if(large)
+	for(std::size_t tile = 0; tile < tiles; ++tile){
+		const std::size_t x0 = tile%tiles_x*warp_tile, y0 = tile/tiles_x*warp_tile;
+		const std::size_t x1 = std::min(x0 + warp_tile, static_cast<std::size_t>(width));
+		const std::size_t y1 = std::min(y0 + warp_tile, static_cast<std::size_t>(height));
+		for(std::size_t h = y0; h < y1; ++h){
+			value_type* const dst = reinterpret_cast<value_type*>(&result[static_cast<row_t>(h)][0]);
+			const double cx = static_cast<double>(x0) + 0.5, cy = static_cast<double>(h) + 0.5;
+			double x = inverse_[0][0]*cx + inverse_[0][1]*cy + inverse_[0][2];
+			double y = inverse_[1][0]*cx + inverse_[1][1]*cy + inverse_[1][2];
+			double z = inverse_[2][0]*cx + inverse_[2][1]*cy + inverse_[2][2];
+			for(std::size_t w = x0; w < x1; ++w, x += inverse_[0][0], y += inverse_[1][0], z += inverse_[2][0]){
+				value_type* const p = dst + w*3;
+				const double u = x/z, v = y/z;
+				if(!(0.0 < z) || !(-2.0 < u && u < limit_u && -2.0 < v && v < limit_v)){
+					std::copy(background, background + 3, p);
+				}else if(interpolation_ == Scale::INTERPOLATION_NEAREST){
+					const value_type* const q = warp_pixel(image, static_cast<std::ptrdiff_t>(std::floor(u)), static_cast<std::ptrdiff_t>(std::floor(v)), background);
+					std::copy(q, q + 3, p);
+				}else if(interpolation_ == Scale::INTERPOLATION_BILINEAR){
+					warp_sample<2>(image, u - 0.5, v - 0.5, background, p);
+				}else{
+					warp_sample<4>(image, u - 0.5, v - 0.5, background, p);
+				}
+			}
 		}
 	}
 	return image.swap(result);
 }
 
-Image& Crop::process(Image& image)const
+RemapTable::Projective::Projective(const Warp::Matrix& matrix): inverse_()
 {
-	if(!within(image)){
-		throw std::invalid_argument(__func__ + std::string(": can not apply Crop process. invalid area specification."));
+	if(!invert(matrix, inverse_)){
+		throw std::invalid_argument(__func__ + std::string(": can not create projective mapping. matrix is singular."));
 	}
+}
 
-	const column_t limit_w = area_.offset_x_ + area_.width_;
-	const row_t limit_h = area_.offset_y_ + area_.height_;
-	Image result = Image(area_.width_, area_.height_);
-	for(row_t h = area_.offset_y_, i = 0; h < limit_h; ++h, ++i){
-		for(column_t w = area_.offset_x_, j = 0; w < limit_w; ++w, ++j){
-			result[i][j] = image[h][w];
+/**
+ * 同次座標の第 3 成分が正でない位置は入力の外にする。
+ */
+void RemapTable::Projective::map(double x, double y, double& u, double& v)const
+{
+	const double z = inverse_[2][0]*x + inverse_[2][1]*y + inverse_[2][2];
+	if(!(0.0 < z)){
+		u = v = -std::numeric_limits<double>::max();
+		return;
+	}
+	u = (inverse_[0][0]*x + inverse_[0][1]*y + inverse_[0][2])/z;
+	v = (inverse_[1][0]*x + inverse_[1][1]*y + inverse_[1][2])/z;
+}
+
+void RemapTable::Radial::map(double x, double y, double& u, double& v)const
+{
+	const double dx = (x - center_x_)/radius_, dy = (y - center_y_)/radius_;
+	const double r2 = dx*dx + dy*dy;
+	const double scale = 1.0 + r2*(k1_ + r2*(k2_ + r2*k3_));
+	u = center_x_ + (x - center_x_)*scale;
+	v = center_y_ + (y - center_y_)*scale;
+}
+
+RemapTable::Mesh::Mesh(double width, double height, column_t columns, row_t rows, const std::vector<double>& points):
+	width_(width), height_(height), columns_(columns), rows_(rows), points_(points)
+{
+	if(columns_ < 2 || rows_ < 2 || points_.size() != static_cast<std::size_t>(columns_)*rows_*2){
+		throw std::invalid_argument(__func__ + std::string(": can not create mesh. grid must be 2x2 or more and points must have columns * rows pairs."));
+	}
+}
+
+RemapTable::Mesh::~Mesh(){}
+
+/**
+ * 格子の外の位置は端の升目を延ばして補う。
+ */
+void RemapTable::Mesh::map(double x, double y, double& u, double& v)const
+{
+	const double gx = x/width_*(columns_ - 1), gy = y/height_*(rows_ - 1);
+	const std::size_t i = static_cast<std::size_t>(std::min(std::max(std::floor(gx), 0.0), static_cast<double>(columns_ - 2)));
+	const std::size_t j = static_cast<std::size_t>(std::min(std::max(std::floor(gy), 0.0), static_cast<double>(rows_ - 2)));
+	const double tx = gx - static_cast<double>(i), ty = gy - static_cast<double>(j);
+	const double* const p00 = &points_[(j*columns_ + i)*2];
+	const double* const p01 = p00 + 2;
+	const double* const p10 = p00 + columns_*2;
+	const double* const p11 = p10 + 2;
+	u = (p00[0]*(1.0 - tx) + p01[0]*tx)*(1.0 - ty) + (p10[0]*(1.0 - tx) + p11[0]*tx)*ty;
+	v = (p00[1]*(1.0 - tx) + p01[1]*tx)*(1.0 - ty) + (p10[1]*(1.0 - tx) + p11[1]*tx)*ty;
+}
+
+RemapTable::RemapTable(column_t width, row_t height, const Mapping& mapping, const Pixel<>& background):
+	width_(width), height_(height), background_(background), entries_(static_cast<std::size_t>(width)*height)
+{
+	if(width_ < 2 || height_ < 2){
+		throw std::invalid_argument(__func__ + std::string(": can not create remap table. width and height must be 2 or more."));
+	}
+	const double limit_u = static_cast<double>(width_) - 0.5, limit_v = static_cast<double>(height_) - 0.5;
+	const double one = 1 << remap_bits;
+	const bool large = tone_parallel_pixels <= entries_.size();
+#pragma omp parallel for schedule(static) if(large)
+	for(row_t h = 0; h < height_; ++h){
+		for(column_t w = 0; w < width_; ++w){
+			Entry& entry = entries_[static_cast<std::size_t>(h)*width_ + w];
+			double u, v;
+			mapping.map(w + 0.5, h + 0.5, u, v);
+			u -= 0.5;
+			v -= 0.5;
+			if(!(-0.5 <= u && u <= limit_u && -0.5 <= v && v <= limit_v)){
+				entry.offset = remap_outside;
+				entry.fraction_x = entry.fraction_y = 0;
+				continue;
+			}
+			u = std::min(std::max(u, 0.0), static_cast<double>(width_ - 1));
+			v = std::min(std::max(v, 0.0), static_cast<double>(height_ - 1));
+			const column_t x0 = std::min(static_cast<column_t>(u), width_ - 2);
+			const row_t y0 = std::min(static_cast<row_t>(v), height_ - 2);
+			entry.offset = y0*width_ + x0;
+			entry.fraction_x = static_cast<uint16_t>(std::floor((u - x0)*one + 0.5));
+			entry.fraction_y = static_cast<uint16_t>(std::floor((v - y0)*one + 0.5));
+		}
+	}
+}
+
+RemapTable::RemapTable(const std::string& filename): width_(0), height_(0), background_(black), entries_()
+{
+	std::ifstream ifs(filename.c_str(), std::ios::binary);
+	if(!ifs){
+		throw std::invalid_argument(__func__ + std::string(": can not open file.: ") + filename);
+	}
+	const std::size_t header_size = sizeof(remap_magic) + 4 + 4 + 2*3;
+	std::vector<byte_t> header(header_size);
+	ifs.read(reinterpret_cast<char*>(&header[0]), static_cast<std::streamsize>(header_size));
+	if(!ifs || !std::equal(remap_magic, remap_magic + sizeof(remap_magic), reinterpret_cast<const char*>(&header[0]))){
+		throw std::invalid_argument(__func__ + std::string(": can not read remap table. broken file: ") + filename);
+	}
+	const byte_t* p = &header[sizeof(remap_magic)];
+	width_ = get_le(p, 4);
+	height_ = get_le(p + 4, 4);
+	background_ = Pixel<>(static_cast<uint16_t>(get_le(p + 8, 2)), static_cast<uint16_t>(get_le(p + 10, 2)), static_cast<uint16_t>(get_le(p + 12, 2)));
+	if(width_ < 2 || height_ < 2 || std::numeric_limits<std::size_t>::max()/8/width_ < height_){
+		throw std::invalid_argument(__func__ + std::string(": can not read remap table. broken file: ") + filename);
+	}
+	const std::size_t size = static_cast<std::size_t>(width_)*height_;
+	std::vector<byte_t> data(size*8);
+	ifs.read(reinterpret_cast<char*>(&data[0]), static_cast<std::streamsize>(data.size()));
+	if(!ifs){
+		throw std::invalid_argument(__func__ + std::string(": can not read remap table. broken file: ") + filename);
+	}
+	// process() は offset から右と下の画素まで読むので、最後の行と最後の列は参照の起点にできない。
+	const uint32_t one = 1u << remap_bits;
+	entries_.resize(size);
+	for(std::size_t i = 0; i < size; ++i){
+		Entry& entry = entries_[i];
+		entry.offset = get_le(&data[i*8], 4);
+		entry.fraction_x = static_cast<uint16_t>(get_le(&data[i*8 + 4], 2));
+		entry.fraction_y = static_cast<uint16_t>(get_le(&data[i*8 + 6], 2));
+		const std::size_t offset = entry.offset;
+		if(offset != remap_outside && (size - width_ <= offset || offset % width_ == width_ - 1u || one < entry.fraction_x || one < entry.fraction_y)){
+			throw std::invalid_argument(__func__ + std::string(": can not read remap table. broken file: ") + filename);
 		}
 	}
-	return image.swap(result);
 }
 
-Image& Filter::process(Image& image)const
+RemapTable::~RemapTable(){}
+
+void RemapTable::write(const std::string& filename)const
 {
-	if(!(kernel_.size() % 2) || kernel_.size() < 2){
-		throw std::runtime_error(__func__ + std::string(": can not apply filter. filter kernel height must be odd number more than 1."));
+	std::vector<byte_t> buffer(remap_magic, remap_magic + sizeof(remap_magic));
+	buffer.reserve(sizeof(remap_magic) + 4 + 4 + 2*3 + entries_.size()*8);
+	put_le(buffer, width_, 4);
+	put_le(buffer, height_, 4);
+	put_le(buffer, background_.R(), 2);
+	put_le(buffer, background_.G(), 2);
+	put_le(buffer, background_.B(), 2);
+	for(std::vector<Entry>::const_iterator i = entries_.begin(); i != entries_.end(); ++i){
+		put_le(buffer, i->offset, 4);
+		put_le(buffer, i->fraction_x, 2);
+		put_le(buffer, i->fraction_y, 2);
 	}
-	const std::size_t kernel_width = kernel_[0].size();
-	for(std::size_t i = 0; i < kernel_.size(); ++i){
-		if(!(kernel_[i].size() % 2) || kernel_[i].size() < 2 || kernel_[i].size() != kernel_width){
-			throw std::runtime_error(__func__ + std::string(": can not apply filter. filter kernel width must be odd number more than 1."));
-		}
+	std::ofstream ofs(filename.c_str(), std::ios::binary);
+	ofs.write(reinterpret_cast<const char*>(&buffer[0]), static_cast<std::streamsize>(buffer.size()));
+	if(!ofs){
+		throw std::invalid_argument(__func__ + std::string(": can not write file.: ") + filename);
 	}
+}
 
-	Image result = Image(image.width(), image.height());
-	for(row_t h = 0; h < image.height(); ++h){
-		const row_t h_lowerbound =
-			static_cast<row_t>(h - kernel_.size()/2 < image.height() ? h - kernel_.size()/2 : 0);
-		const row_t h_upperbound = std::min(
-			static_cast<row_t>(h + kernel_.size()/2 + 1), image.height());
-		for(column_t w = 0; w < image.width(); ++w){
-			const column_t w_lowerbound =
-				static_cast<column_t>(w - kernel_[0].size()/2 < image.width() ? w - kernel_[0].size()/2 : 0);
-			const column_t w_upperbound = std::min(
-				static_cast<column_t>(w + kernel_[0].size()/2 + 1), image.width());
-			Pixel<double> pixel = black;
-			for(row_t hh = h_lowerbound, i = 0; hh < h_upperbound; ++hh, ++i){
-				for(column_t ww = w_lowerbound, j = 0; ww < w_upperbound; ++ww, ++j){
-					pixel = pixel + Pixel<double>(image[hh][ww]) * kernel_[i][j];
-				}
+Image& RemapTable::process(Image& image)const
+{
+	if(image.width() != width_ || image.height() != height_){
+		throw std::invalid_argument(__func__ + std::string(": can not remap. image width/height unmatch."));
+	}
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[0][0]);
+	const std::size_t stride = width_*3u;
+	const uint32_t one = 1u << remap_bits, half = 1u << (remap_bits*2 - 1);
+	const value_type background[3] = {background_.R(), background_.G(), background_.B()};
+	Image result(width_, height_);
+	const bool large = tone_parallel_pixels <= entries_.size();
+#pragma omp parallel for schedule(static) if(large)
+	for(row_t h = 0; h < height_; ++h){
+		const Entry* const entry = &entries_[static_cast<std::size_t>(h)*width_];
+		value_type* const dst = reinterpret_cast<value_type*>(&result[h][0]);
+		for(column_t w = 0; w < width_; ++w){
+			const Entry& e = entry[w];
+			if(e.offset == remap_outside){
+				std::copy(background, background + 3, dst + w*3);
+				continue;
+			}
+			const value_type* const top = src + static_cast<std::size_t>(e.offset)*3;
+			const value_type* const bottom = top + stride;
+			const uint32_t fx = e.fraction_x, fy = e.fraction_y;
+			for(std::size_t c = 0; c < 3; ++c){
+				const uint32_t upper = top[c]*(one - fx) + top[c + 3]*fx;
+				const uint32_t lower = bottom[c]*(one - fx) + bottom[c + 3]*fx;
+				dst[w*3 + c] = static_cast<value_type>((upper*(one - fy) + lower*fy + half) >> (remap_bits*2));
 			}
-			result[h][w] = pixel;
 		}
 	}
 	return image.swap(result);
 }
 
-Filter::Kernel WeightedSmoothing::init()
+Image& KeyStone::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back(0/13.0);
-	kernel[0].push_back(0/13.0);
-	kernel[0].push_back(1/13.0);
-	kernel[0].push_back(0/13.0);
-	kernel[0].push_back(0/13.0);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back(0/13.0);
-	kernel[1].push_back(1/13.0);
-	kernel[1].push_back(1/13.0);
-	kernel[1].push_back(1/13.0);
-	kernel[1].push_back(0/13.0);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back(1/13.0);
-	kernel[2].push_back(1/13.0);
-	kernel[2].push_back(1/13.0);
-	kernel[2].push_back(1/13.0);
-	kernel[2].push_back(1/13.0);
-	kernel.push_back(KernelRow());
-	kernel[3].push_back(0/13.0);
-	kernel[3].push_back(1/13.0);
-	kernel[3].push_back(1/13.0);
-	kernel[3].push_back(1/13.0);
-	kernel[3].push_back(0/13.0);
-	kernel.push_back(KernelRow());
-	kernel[4].push_back(0/13.0);
-	kernel[4].push_back(0/13.0);
-	kernel[4].push_back(1/13.0);
-	kernel[4].push_back(0/13.0);
-	kernel[4].push_back(0/13.0);
-	return kernel;
+	const double width = static_cast<double>(image.width()), height = static_cast<double>(image.height());
+	const double source[4][2] = {{0.0, 0.0}, {width, 0.0}, {0.0, height}, {width, height}};
+	double destination[4][2] = {{0.0, 0.0}, {width, 0.0}, {0.0, height}, {width, height}};
+	const int corner = vertex_ == TOP_LEFT ? 0 : vertex_ == TOP_RIGHT ? 1 : vertex_ == BOTTOM_LEFT ? 2 : 3;
+	destination[corner][0] += corner % 2 ? -static_cast<double>(width_offset_) : static_cast<double>(width_offset_);
+	destination[corner][1] += corner / 2 ? -static_cast<double>(height_offset_) : static_cast<double>(height_offset_);
+	Warp::Matrix m;
+	Warp::homography(source, destination, m);
+	return image >>= Warp(m, interpolation_);
 }
 
-Filter::Kernel UnSharpMask::init()
+Image& Transpose::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back( 0);
-	kernel[0].push_back(-1);
-	kernel[0].push_back( 0);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back(-1);
-	kernel[1].push_back( 5);
-	kernel[1].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back( 0);
-	kernel[2].push_back(-1);
-	kernel[2].push_back( 0);
-	return kernel;
+	return image.width() == image.height() ? transpose_square(image) : turn_image(image, TURN_TRANSPOSE);
 }
 
-Filter::Kernel Prewitt::init()
+Image& Rotate90::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back( 0);
-	kernel[1].push_back( 0);
-	kernel[1].push_back( 0);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back( 1);
-	kernel[2].push_back( 1);
-	kernel[2].push_back( 1);
-	return kernel;
+	return image.width() == image.height() ? flip_horizontal(transpose_square(image)) : turn_image(image, TURN_ROTATE90);
 }
 
-Filter::Kernel Sobel::init()
+/**
+ * 画素の並び全体を前後から入れ替える。
+ */
+Image& Rotate180::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-2);
-	kernel[0].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back( 0);
-	kernel[1].push_back( 0);
-	kernel[1].push_back( 0);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back( 1);
-	kernel[2].push_back( 2);
-	kernel[2].push_back( 1);
-	return kernel;
+	Image::pixel_type* const p = &image[0][0];
+	const std::size_t size = static_cast<std::size_t>(image.width())*image.height();
+	const bool large = tone_parallel_pixels <= size;
+#pragma omp parallel for schedule(static) if(large)
+	for(std::size_t i = 0; i < size/2; ++i){
+		std::swap(p[i], p[size - 1 - i]);
+	}
+	return image;
 }
 
-Filter::Kernel Laplacian3x3::init()
+Image& Rotate270::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back(-1);
-	kernel[1].push_back( 8);
-	kernel[1].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back(-1);
-	kernel[2].push_back(-1);
-	kernel[2].push_back(-1);
-	return kernel;
+	return image.width() == image.height() ? flip_vertical(transpose_square(image)) : turn_image(image, TURN_ROTATE270);
 }
 
-Filter::Kernel Laplacian5x5::init()
+Image& FlipH::process(Image& image)const
 {
-	Kernel kernel;
-	kernel.push_back(KernelRow());
-	kernel[0].push_back(-1);
-	kernel[0].push_back(-3);
-	kernel[0].push_back(-4);
-	kernel[0].push_back(-3);
-	kernel[0].push_back(-1);
-	kernel.push_back(KernelRow());
-	kernel[1].push_back(-3);
-	kernel[1].push_back( 0);
-	kernel[1].push_back( 6);
-	kernel[1].push_back( 0);
-	kernel[1].push_back(-3);
-	kernel.push_back(KernelRow());
-	kernel[2].push_back(-4);
-	kernel[2].push_back( 6);
-	kernel[2].push_back(20);
-	kernel[2].push_back( 6);
-	kernel[2].push_back(-4);
-	kernel.push_back(KernelRow());
-	kernel[3].push_back(-3);
-	kernel[3].push_back( 0);
-	kernel[3].push_back( 6);
-	kernel[3].push_back( 0);
-	kernel[3].push_back(-3);
-	kernel.push_back(KernelRow());
-	kernel[4].push_back(-1);
-	kernel[4].push_back(-3);
-	kernel[4].push_back(-4);
-	kernel[4].push_back(-3);
-	kernel[4].push_back(-1);
-	return kernel;
+	return flip_horizontal(image);
+}
+
+Image& FlipV::process(Image& image)const
+{
+	return flip_vertical(image);
 }
 
 /**
- * @TODO アルゴリズムがイケてないので改善する。
+ * 圧縮は ACES の Reference Gamut Compression と同じく、各チャンネルの無彩色からの距離
+ * d = (max(r, g, b) - c)/max(r, g, b) に対して閾値 t より外側を
+ * t + (d - t)/(1 + (d - t)/s) で曲げる(指数 1 の場合なので画素ごとの pow() はない)。
+ * 距離の上限は変換元の色域表面(いずれかのチャンネルが 1 の面)を標本化して求め、
+ * 上限がちょうど 1 (変換先の色域境界)に写るように s を決める。
  */
-Image& HScale::process(Image& image)const
+GamutMapping::GamutMapping(const Primaries& source, const Primaries& destination,
+		const TransferFunction& transfer, bool compression): transfer_(transfer)
 {
-	Image result(width_, image.height());
-	for(row_t h = 0; h < image.height(); ++h){
-		for(column_t w = 0; w < width_; ++w){
-			result[h][w] = image[h][w * image.width() / width_];
+	const double threshold = 0.8;
+	const int samples = 64;
+	Primaries::Matrix m;
+	destination.conversion_from(source, m);
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			matrix_[i][j] = static_cast<float>(m[i][j]);
+		}
+	}
+
+	double limit[3] = {0.0, 0.0, 0.0};
+	for(int face = 0; face < 3; ++face){
+		for(int i = 0; i <= samples; ++i){
+			for(int j = 0; j <= samples; ++j){
+				double rgb[3];
+				rgb[face] = 1.0;
+				rgb[(face + 1)%3] = static_cast<double>(i)/samples;
+				rgb[(face + 2)%3] = static_cast<double>(j)/samples;
+				double c[3];
+				for(int k = 0; k < 3; ++k){
+					c[k] = m[k][0]*rgb[0] + m[k][1]*rgb[1] + m[k][2]*rgb[2];
+				}
+				const double achromatic = std::max(c[0], std::max(c[1], c[2]));
+				for(int k = 0; 0.0 < achromatic && k < 3; ++k){
+					limit[k] = std::max(limit[k], (achromatic - c[k])/achromatic);
+				}
+			}
+		}
+	}
+	for(int k = 0; k < 3; ++k){
+		if(compression && 1.0 < limit[k]){
+			threshold_[k] = static_cast<float>(threshold);
+			slope_[k] = static_cast<float>(((limit[k] - threshold)/(1.0 - threshold) - 1.0)/(limit[k] - threshold));
+		}else{
+			threshold_[k] = std::numeric_limits<float>::max();
+			slope_[k] = 0.0f;
 		}
 	}
-	return image.swap(result);
 }
 
+GamutMapping::~GamutMapping(){}
+
 /**
- * @TODO アルゴリズムがイケてないので改善する。
+ * 行単位でスレッドに分配し、行内は復号した値をチャンネル別の float 配列に並べ替えて
+ * 分岐のないループ(行列演算と圧縮が SIMD 命令にベクトル化される)で処理する。
  */
-Image& VScale::process(Image& image)const
+Image& GamutMapping::process(Image& image)const
 {
-	Image result(image.width(), height_);
-	for(column_t w = 0; w < image.width(); ++w){
-		for(row_t h = 0; h < height_; ++h){
-			result[h][w] = image[h * image.height() / height_][w];
+	const column_t width = image.width();
+	const row_t height = image.height();
+	const float m00 = matrix_[0][0], m01 = matrix_[0][1], m02 = matrix_[0][2];
+	const float m10 = matrix_[1][0], m11 = matrix_[1][1], m12 = matrix_[1][2];
+	const float m20 = matrix_[2][0], m21 = matrix_[2][1], m22 = matrix_[2][2];
+	const float tr = threshold_[0], tg = threshold_[1], tb = threshold_[2];
+	const float sr = slope_[0], sg = slope_[1], sb = slope_[2];
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel if(large)
+	{
+		std::vector<float> buffer(width*3u);
+		float* const r = &buffer[0];
+		float* const g = r + width;
+		float* const b = g + width;
+#pragma omp for schedule(static)
+		for(row_t h = 0; h < height; ++h){
+			value_type* const row = reinterpret_cast<value_type*>(&image[h][0]);
+			for(column_t w = 0; w < width; ++w){
+				r[w] = transfer_.decode(row[w*3 + 0]);
+				g[w] = transfer_.decode(row[w*3 + 1]);
+				b[w] = transfer_.decode(row[w*3 + 2]);
+			}
+			for(column_t w = 0; w < width; ++w){
+				const float cr = m00*r[w] + m01*g[w] + m02*b[w];
+				const float cg = m10*r[w] + m11*g[w] + m12*b[w];
+				const float cb = m20*r[w] + m21*g[w] + m22*b[w];
+				const float achromatic = std::max(cr, std::max(cg, cb));
+				const float reciprocal = 0.0f < achromatic ? 1.0f/achromatic : 0.0f;
+				const float dr = (achromatic - cr)*reciprocal - tr;
+				const float dg = (achromatic - cg)*reciprocal - tg;
+				const float db = (achromatic - cb)*reciprocal - tb;
+				const float er = 0.0f < dr ? dr/(1.0f + dr*sr) + tr : dr + tr;
+				const float eg = 0.0f < dg ? dg/(1.0f + dg*sg) + tg : dg + tg;
+				const float eb = 0.0f < db ? db/(1.0f + db*sb) + tb : db + tb;
+				r[w] = 0.0f < dr ? achromatic - er*achromatic : cr;
+				g[w] = 0.0f < dg ? achromatic - eg*achromatic : cg;
+				b[w] = 0.0f < db ? achromatic - eb*achromatic : cb;
+			}
+			for(column_t w = 0; w < width; ++w){
+				row[w*3 + 0] = transfer_.encode(r[w]);
+				row[w*3 + 1] = transfer_.encode(g[w]);
+				row[w*3 + 2] = transfer_.encode(b[w]);
+			}
 		}
 	}
-	return image.swap(result);
+	return image;
 }
 
-Image& KeyStone::process(Image& image)const
+namespace{
+
+const unsigned int bayer_order      = 4;
+const unsigned int blue_noise_order = 6;
+const unsigned int full_scale       = 0xffffu;
+
+/**
+ * 2^order 四方の Bayer 行列。x^y と y のビットを交互に並べて上下反転した値が順位になる。
+ */
+std::vector<unsigned int> bayer(unsigned int order)
 {
-	Image phase1 = Image(image.width(), image.height());
-	Image phase2 = Image(image.width(), image.height());
-	phase1 >>= Luster(black);
-	phase2 >>= Luster(black);
-	switch(vertex_){
-	case TOP_LEFT:
-		for(row_t h = 0; h < image.height(); ++h){
-			const column_t current_offset = width_offset_*(image.height() - h)/image.height();
-			for(column_t w = 0; w < image.width() - current_offset; ++w){
-				phase1[h][w + current_offset] = image[h][w*image.width()/(image.width() - current_offset)];
+	const unsigned int size = 1u << order;
+	std::vector<unsigned int> matrix(size*size);
+	for(unsigned int y = 0; y < size; ++y){
+		for(unsigned int x = 0; x < size; ++x){
+			unsigned int rank = 0;
+			for(unsigned int bit = 0; bit < order; ++bit){
+				const unsigned int shift = 2*(order - 1 - bit);
+				rank |= (((x ^ y) >> bit) & 1u) << (shift + 1);
+				rank |= ((y >> bit) & 1u) << shift;
 			}
+			matrix[y*size + x] = rank;
 		}
-		for(column_t w = 0; w < image.width(); ++w){
-			const row_t current_offset = height_offset_*(image.width() - w)/(image.width() - width_offset_);
-			for(row_t h = 0; h < image.height() - current_offset; ++h){
-				phase2[h + current_offset][w] = phase1[h*image.height()/(image.height() - current_offset)][w];
-			}
+	}
+	return matrix;
+}
+
+void toggle(std::vector<char>& pattern, std::vector<double>& energy, const std::vector<double>& gaussian,
+		unsigned int order, unsigned int index)
+{
+	const unsigned int size = 1u << order;
+	const unsigned int mask = size - 1;
+	const unsigned int px = index & mask;
+	const unsigned int py = index >> order;
+	const double sign = pattern[index] ? -1.0 : 1.0;
+	pattern[index] = !pattern[index];
+	for(unsigned int y = 0; y < size; ++y){
+		const double* const g = &gaussian[((y - py) & mask) << order];
+		double* const e = &energy[y << order];
+		for(unsigned int x = 0; x < size; ++x){
+			e[x] += sign*g[(x - px) & mask];
 		}
-		break;
-	case TOP_RIGHT:
-		for(row_t h = 0; h < image.height(); ++h){
-			const column_t current_offset = width_offset_*(image.height() - h)/image.height();
-			for(column_t w = 0; w < image.width() - current_offset; ++w){
-				phase1[h][w] = image[h][w*image.width()/(image.width() - current_offset)];
-			}
+	}
+}
+
+/**
+ * value の画素のうち、エネルギーが最大(tightest cluster)または最小(largest void)のもの。
+ */
+unsigned int extremum(const std::vector<char>& pattern, const std::vector<double>& energy, char value, bool maximum)
+{
+	unsigned int result = 0;
+	bool found = false;
+	for(unsigned int i = 0; i < pattern.size(); ++i){
+		if(pattern[i] == value && (!found || (maximum ? energy[result] < energy[i] : energy[i] < energy[result]))){
+			result = i;
+			found = true;
 		}
-		for(column_t w = 0; w < image.width(); ++w){
-			const row_t current_offset = height_offset_*w/(image.width() - width_offset_);
-			for(row_t h = 0; h < image.height() - current_offset; ++h){
-				phase2[h + current_offset][w] = phase1[h*image.height()/(image.height() - current_offset)][w];
-			}
+	}
+	return result;
+}
+
+/**
+ * Ulichney の void-and-cluster 法で作る 2^order 四方のブルーノイズ行列(トーラス状に繰り返せる)。
+ * 全レベルの半分を過ぎてからの「0 の最も密な所」は「1 のエネルギーが最小の 0」と同じなので、
+ * 後半も largest void を順に埋めていく。
+ */
+std::vector<unsigned int> blue_noise(unsigned int order)
+{
+	const unsigned int size = 1u << order;
+	const unsigned int area = size*size;
+	const double sigma = 1.5;
+	std::vector<double> gaussian(area);
+	for(unsigned int y = 0; y < size; ++y){
+		for(unsigned int x = 0; x < size; ++x){
+			const double dx = std::min(x, size - x);
+			const double dy = std::min(y, size - y);
+			gaussian[y*size + x] = std::exp(-(dx*dx + dy*dy)/(2.0*sigma*sigma));
 		}
-		break;
-	case BOTTOM_LEFT:
-		for(row_t h = 0; h < image.height(); ++h){
-			const column_t current_offset = width_offset_*h/image.height();
-			for(column_t w = 0; w < image.width() - current_offset; ++w){
-				phase1[h][w + current_offset] = image[h][w*image.width()/(image.width() - current_offset)];
-			}
+	}
+
+	std::vector<char> pattern(area, 0);
+	std::vector<double> energy(area, 0.0);
+	const unsigned int ones = area/10;
+	unsigned int seed = 1u;
+	for(unsigned int placed = 0; placed < ones;){
+		seed = seed*1103515245u + 12345u;
+		const unsigned int index = (seed >> 8) % area;
+		if(!pattern[index]){
+			toggle(pattern, energy, gaussian, order, index);
+			++placed;
 		}
-		for(column_t w = 0; w < image.width(); ++w){
-			const row_t current_offset = height_offset_*(image.width() - w)/(image.width() - width_offset_);
-			for(row_t h = 0; h < image.height() - current_offset; ++h){
-				phase2[h][w] = phase1[h*image.height()/(image.height() - current_offset)][w];
-			}
+	}
+	for(;;){
+		const unsigned int cluster = extremum(pattern, energy, 1, true);
+		toggle(pattern, energy, gaussian, order, cluster);
+		const unsigned int largest_void = extremum(pattern, energy, 0, false);
+		toggle(pattern, energy, gaussian, order, largest_void);
+		if(largest_void == cluster){
+			break;
 		}
-		break;
-	case BOTTOM_RIGHT:
-		for(row_t h = 0; h < image.height(); ++h){
-			const column_t current_offset = width_offset_*h/image.height();
-			for(column_t w = 0; w < image.width() - current_offset; ++w){
-				phase1[h][w] = image[h][w*image.width()/(image.width() - current_offset)];
+	}
+
+	std::vector<unsigned int> matrix(area);
+	std::vector<char> removing(pattern);
+	std::vector<double> removing_energy(energy);
+	for(unsigned int rank = ones; 0 < rank; --rank){
+		const unsigned int cluster = extremum(removing, removing_energy, 1, true);
+		toggle(removing, removing_energy, gaussian, order, cluster);
+		matrix[cluster] = rank - 1;
+	}
+	for(unsigned int rank = ones; rank < area; ++rank){
+		const unsigned int largest_void = extremum(pattern, energy, 0, false);
+		toggle(pattern, energy, gaussian, order, largest_void);
+		matrix[largest_void] = rank;
+	}
+	return matrix;
+}
+
+/**
+ * 量子化レベル q に割り付ける 16bit の値。gather 命令で引けるように 32bit で持つ。
+ */
+std::vector<unsigned int> dither_levels(byte_t bits)
+{
+	const unsigned int maximum = (1u << bits) - 1u;
+	std::vector<unsigned int> levels(maximum + 1u);
+	for(unsigned int q = 0; q <= maximum; ++q){
+		levels[q] = (q*full_scale + maximum/2u)/maximum;
+	}
+	return levels;
+}
+
+}
+
+Image& Dither::process(Image& image)const
+{
+	if(bits_ < 1 || 15 < bits_){
+		throw std::invalid_argument(__func__ + std::string(": can not apply Dither process. bits must be 1 to 15."));
+	}
+	switch(method_){
+	case BAYER:{
+		static const std::vector<unsigned int> matrix = bayer(bayer_order);
+		return ordered(image, matrix, bayer_order);
+	}
+	case BLUE_NOISE:{
+		static const std::vector<unsigned int> matrix = blue_noise(blue_noise_order);
+		return ordered(image, matrix, blue_noise_order);
+	}
+	case FLOYD_STEINBERG:
+		return diffuse(image);
+	default:
+		throw std::invalid_argument(__func__ + std::string(": can not apply Dither process. unknown method."));
+	}
+}
+
+/**
+ * q = floor((v*maximum + t)/65535) で、t は行列の順位を (0, 65535) に均等に割り付けた閾値。
+ * 3 チャンネルに同じ閾値を使うので無彩色は無彩色のまま量子化される。
+ * 1 行分の閾値を行列の幅ごとに展開しておき、内側のループは 16bit 値の積和と
+ * 定数除算とレベルのテーブル引きだけ(gather 命令を使ってベクトル化される)にする。
+ */
+Image& Dither::ordered(Image& image, const std::vector<unsigned int>& matrix, unsigned int order)const
+{
+	const unsigned int size = 1u << order;
+	const unsigned int area = size*size;
+	const unsigned int maximum = (1u << bits_) - 1u;
+	const std::vector<unsigned int> levels = dither_levels(bits_);
+	const unsigned int* const level = &levels[0];
+	const column_t width = image.width();
+	const row_t height = image.height();
+	const std::size_t span = size*3u;
+	const std::size_t stride = width*3u;
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel if(large)
+	{
+		std::vector<unsigned int> thresholds(span);
+#pragma omp for schedule(static)
+		for(row_t h = 0; h < height; ++h){
+			const unsigned int* const ranks = &matrix[(h & (size - 1u))*size];
+			for(unsigned int x = 0; x < size; ++x){
+				const unsigned int threshold = ((2u*ranks[x] + 1u)*full_scale)/(2u*area);
+				thresholds[x*3 + 0] = thresholds[x*3 + 1] = thresholds[x*3 + 2] = threshold;
+			}
+			value_type* const row = reinterpret_cast<value_type*>(&image[h][0]);
+			for(std::size_t first = 0; first < stride; first += span){
+				const std::size_t count = std::min(span, stride - first);
+				value_type* const values = row + first;
+				const unsigned int* const threshold = &thresholds[0];
+				for(std::size_t k = 0; k < count; ++k){
+					const unsigned int value = values[k];
+					values[k] = static_cast<value_type>(level[(value*maximum + threshold[k])/full_scale]);
+				}
 			}
 		}
-		for(column_t w = 0; w < image.width(); ++w){
-			const row_t current_offset = height_offset_*w/(image.width() - width_offset_);
-			for(row_t h = 0; h < image.height() - current_offset; ++h){
-				phase2[h][w] = phase1[h*image.height()/(image.height() - current_offset)][w];
+	}
+	return image;
+}
+
+/**
+ * 誤差は 16bit の値の単位の整数で持ち、右へ 7/16、左下・下・右下へ 3/16, 5/16, 1/16 を配る
+ * (切り捨ての端数は右下に寄せて総量を保つ)。
+ * 下の行への誤差は 2 行分のバッファを交互に使う。行 h の w 列目の処理は行 h - 1 が
+ * w + 1 列目まで終わっていれば始められ、その時点で同じバッファの w + 1 列目までは
+ * 行 h - 1 が読み終えているので、右下への配分は加算ではなく代入で初期化を兼ねる。
+ */
+Image& Dither::diffuse(Image& image)const
+{
+	const column_t block = 64;
+	const unsigned int maximum = (1u << bits_) - 1u;
+	const std::vector<unsigned int> levels = dither_levels(bits_);
+	const column_t width = image.width();
+	const row_t height = image.height();
+	const std::size_t stride = width*3u;
+	std::vector<int> buffer(2*(stride + 3u), 0);
+	std::vector<column_t> progress(height, 0);
+	const int threads = spin_threads();
+	const bool large = tone_parallel_pixels <= static_cast<std::size_t>(width)*height;
+
+#pragma omp parallel for schedule(static, 1) num_threads(threads) if(large)
+	for(row_t h = 0; h < height; ++h){
+		value_type* const row = reinterpret_cast<value_type*>(&image[h][0]);
+		const int* const below = &buffer[(h & 1u)*(stride + 3u)];
+		int* const next = &buffer[((h + 1u) & 1u)*(stride + 3u)];
+		int carry[3] = {0, 0, 0};
+		for(column_t first = 0; first < width; first += block){
+			const column_t last = std::min(first + block, width);
+			if(0 < h){
+				const column_t needed = std::min(last + 1, width);
+				column_t done = 0;
+				do{
+#pragma omp atomic read
+					done = progress[h - 1];
+				}while(done < needed);
+#pragma omp flush
+			}
+			for(column_t w = first; w < last; ++w){
+				for(std::size_t c = 0; c < 3; ++c){
+					const std::size_t k = w*3u + c;
+					const int value = row[k] + carry[c] + below[k];
+					const int clamped = std::min(std::max(value, 0), static_cast<int>(full_scale));
+					const int level = static_cast<int>(levels[(static_cast<unsigned int>(clamped)*maximum + full_scale/2u)/full_scale]);
+					const int error = value - level;
+					const int right = error*7/16, left = error*3/16, down = error*5/16;
+					row[k] = static_cast<value_type>(level);
+					carry[c] = right;
+					if(0 < w){
+						next[k - 3] += left;
+						next[k] += down;
+					}else{
+						next[k] = down;
+					}
+					next[k + 3] = error - right - left - down;
+				}
 			}
+#pragma omp flush
+#pragma omp atomic write
+			progress[h] = last;
 		}
-		break;
-	default:
-		break;
 	}
-	return image.swap(phase2);
+	return image;
 }
@@ -0,0 +1,23 @@
+#include "LinearImage.hpp"
+#include "TransferFunction.hpp"
+
+LinearImage::LinearImage(const Image& image, const TransferFunction& tf):
+	data_(image.data_size()/sizeof(Image::pixel_type::value_type)), width_(image.width()), height_(image.height())
+{
+	const Image::pixel_type::value_type* const src = reinterpret_cast<const Image::pixel_type::value_type*>(&image[0][0]);
+	for(std::size_t i = 0; i < data_.size(); ++i){
+		data_[i] = tf.decode(src[i]);
+	}
+}
+
+LinearImage::~LinearImage(){}
+
+Image LinearImage::encode(const TransferFunction& tf)const
+{
+	Image result(width_, height_);
+	Image::pixel_type::value_type* const dst = reinterpret_cast<Image::pixel_type::value_type*>(&result[0][0]);
+	for(std::size_t i = 0; i < data_.size(); ++i){
+		dst[i] = tf.encode(data_[i]);
+	}
+	return result;
+}
@@ -13,6 +13,7 @@
 #include "Image.hpp"
 #include "PatternGenerators.hpp"
 #include "Painter.hpp"
+#include "TransferFunction.hpp"
 
 Image& ColorBar::generate(Image& image)const
 {
@@ -1488,3 +1489,610 @@ Image& Circle::generate(Image& image)const
 	}
 	return image;
 }
+
+/**
+ * CIE 1931 2 度視野の等色関数(nm, x(λ), y(λ), z(λ))、360-830nm を 1nm 刻み。
+ */
+const double color_matching_functions[][4] = {
+	{360, 0.0001299000, 0.000003917000, 0.0006061000},
+	{361, 0.0001458470, 0.000004393581, 0.0006808792},
+	{362, 0.0001638021, 0.000004929604, 0.0007651456},
+	{363, 0.0001840037, 0.000005532136, 0.0008600124},
+	{364, 0.0002066902, 0.000006208245, 0.0009665928},
+	{365, 0.0002321000, 0.000006965000, 0.001086000},
+	{366, 0.0002607280, 0.000007813219, 0.001220586},
+	{367, 0.0002930750, 0.000008767336, 0.001372729},
+	{368, 0.0003293880, 0.000009839844, 0.001543579},
+	{369, 0.0003699140, 0.00001104323, 0.001734286},
+	{370, 0.0004149000, 0.00001239000, 0.001946000},
+	{371, 0.0004641587, 0.00001388641, 0.002177777},
+	{372, 0.0005189860, 0.00001555728, 0.002435809},
+	{373, 0.0005818540, 0.00001744296, 0.002731953},
+	{374, 0.0006552347, 0.00001958375, 0.003078064},
+	{375, 0.0007416000, 0.00002202000, 0.003486000},
+	{376, 0.0008450296, 0.00002483965, 0.003975227},
+	{377, 0.0009645268, 0.00002804126, 0.004540880},
+	{378, 0.001094949, 0.00003153104, 0.005158320},
+	{379, 0.001231154, 0.00003521521, 0.005802907},
+	{380, 0.001368000, 0.00003900000, 0.006450001},
+	{381, 0.001502050, 0.00004282640, 0.007083216},
+	{382, 0.001642328, 0.00004691460, 0.007745488},
+	{383, 0.001802382, 0.00005158960, 0.008501152},
+	{384, 0.001995757, 0.00005717640, 0.009414544},
+	{385, 0.002236000, 0.00006400000, 0.01054999},
+	{386, 0.002535385, 0.00007234421, 0.01196580},
+	{387, 0.002892603, 0.00008221224, 0.01365587},
+	{388, 0.003300829, 0.00009350816, 0.01558805},
+	{389, 0.003753236, 0.0001061361, 0.01773015},
+	{390, 0.004243000, 0.0001200000, 0.02005001},
+	{391, 0.004762389, 0.0001349840, 0.02251136},
+	{392, 0.005330048, 0.0001514920, 0.02520288},
+	{393, 0.005978712, 0.0001702080, 0.02827972},
+	{394, 0.006741117, 0.0001918160, 0.03189704},
+	{395, 0.007650000, 0.0002170000, 0.03621000},
+	{396, 0.008751373, 0.0002469067, 0.04143771},
+	{397, 0.01002888, 0.0002812400, 0.04750372},
+	{398, 0.01142170, 0.0003185200, 0.05411988},
+	{399, 0.01286901, 0.0003572667, 0.06099803},
+	{400, 0.01431000, 0.0003960000, 0.06785001},
+	{401, 0.01570443, 0.0004337147, 0.07448632},
+	{402, 0.01714744, 0.0004730240, 0.08136156},
+	{403, 0.01878122, 0.0005178760, 0.08915364},
+	{404, 0.02074801, 0.0005722187, 0.09854048},
+	{405, 0.02319000, 0.0006400000, 0.1102000},
+	{406, 0.02620736, 0.0007245600, 0.1246133},
+	{407, 0.02978248, 0.0008255000, 0.1417017},
+	{408, 0.03388092, 0.0009411600, 0.1613035},
+	{409, 0.03846824, 0.001069880, 0.1832568},
+	{410, 0.04351000, 0.001210000, 0.2074000},
+	{411, 0.04899560, 0.001362091, 0.2336921},
+	{412, 0.05502260, 0.001530752, 0.2626114},
+	{413, 0.06171880, 0.001720368, 0.2947746},
+	{414, 0.06921200, 0.001935323, 0.3307985},
+	{415, 0.07763000, 0.002180000, 0.3713000},
+	{416, 0.08695811, 0.002454800, 0.4162091},
+	{417, 0.09717672, 0.002764000, 0.4654642},
+	{418, 0.1084063, 0.003117800, 0.5196948},
+	{419, 0.1207672, 0.003526400, 0.5795303},
+	{420, 0.1343800, 0.004000000, 0.6456000},
+	{421, 0.1493582, 0.004546240, 0.7184838},
+	{422, 0.1653957, 0.005159320, 0.7967133},
+	{423, 0.1819831, 0.005829280, 0.8778459},
+	{424, 0.1986110, 0.006546160, 0.9594390},
+	{425, 0.2147700, 0.007300000, 1.0390501},
+	{426, 0.2301868, 0.008086507, 1.1153673},
+	{427, 0.2448797, 0.008908720, 1.1884971},
+	{428, 0.2587773, 0.009767680, 1.2581233},
+	{429, 0.2718079, 0.01066443, 1.3239296},
+	{430, 0.2839000, 0.01160000, 1.3856000},
+	{431, 0.2949438, 0.01257317, 1.4426352},
+	{432, 0.3048965, 0.01358272, 1.4948035},
+	{433, 0.3137873, 0.01462968, 1.5421903},
+	{434, 0.3216454, 0.01571509, 1.5848807},
+	{435, 0.3285000, 0.01684000, 1.6229600},
+	{436, 0.3343513, 0.01800736, 1.6564048},
+	{437, 0.3392101, 0.01921448, 1.6852959},
+	{438, 0.3431213, 0.02045392, 1.7098745},
+	{439, 0.3461296, 0.02171824, 1.7303821},
+	{440, 0.3482800, 0.02300000, 1.7470600},
+	{441, 0.3495999, 0.02429461, 1.7600446},
+	{442, 0.3501474, 0.02561024, 1.7696233},
+	{443, 0.3500130, 0.02695857, 1.7762637},
+	{444, 0.3492870, 0.02835125, 1.7804334},
+	{445, 0.3480600, 0.02980000, 1.7826000},
+	{446, 0.3463733, 0.03131083, 1.7829682},
+	{447, 0.3442624, 0.03288368, 1.7816998},
+	{448, 0.3418088, 0.03452112, 1.7791982},
+	{449, 0.3390941, 0.03622571, 1.7758671},
+	{450, 0.3362000, 0.03800000, 1.7721100},
+	{451, 0.3331977, 0.03984667, 1.7682589},
+	{452, 0.3300411, 0.04176800, 1.7640390},
+	{453, 0.3266357, 0.04376600, 1.7589438},
+	{454, 0.3228868, 0.04584267, 1.7524663},
+	{455, 0.3187000, 0.04800000, 1.7441000},
+	{456, 0.3140251, 0.05024368, 1.7335595},
+	{457, 0.3088840, 0.05257304, 1.7208581},
+	{458, 0.3032904, 0.05498056, 1.7059369},
+	{459, 0.2972579, 0.05745872, 1.6887372},
+	{460, 0.2908000, 0.06000000, 1.6692000},
+	{461, 0.2839701, 0.06260197, 1.6475287},
+	{462, 0.2767214, 0.06527752, 1.6234127},
+	{463, 0.2689178, 0.06804208, 1.5960223},
+	{464, 0.2604227, 0.07091109, 1.5645280},
+	{465, 0.2511000, 0.07390000, 1.5281000},
+	{466, 0.2408475, 0.07701600, 1.4861114},
+	{467, 0.2298512, 0.08026640, 1.4395215},
+	{468, 0.2184072, 0.08366680, 1.3898799},
+	{469, 0.2068115, 0.08723280, 1.3387362},
+	{470, 0.1953600, 0.09098000, 1.2876400},
+	{471, 0.1842136, 0.09491755, 1.2374223},
+	{472, 0.1733273, 0.09904584, 1.1878243},
+	{473, 0.1626881, 0.1033674, 1.1387611},
+	{474, 0.1522833, 0.1078846, 1.0901480},
+	{475, 0.1421000, 0.1126000, 1.0419000},
+	{476, 0.1321786, 0.1175320, 0.9941976},
+	{477, 0.1225696, 0.1226744, 0.9473473},
+	{478, 0.1132752, 0.1279928, 0.9014531},
+	{479, 0.1042979, 0.1334528, 0.8566193},
+	{480, 0.09564000, 0.1390200, 0.8129501},
+	{481, 0.08729955, 0.1446764, 0.7705173},
+	{482, 0.07930804, 0.1504693, 0.7294448},
+	{483, 0.07171776, 0.1564619, 0.6899136},
+	{484, 0.06458099, 0.1627177, 0.6521049},
+	{485, 0.05795001, 0.1693000, 0.6162000},
+	{486, 0.05186211, 0.1762431, 0.5823286},
+	{487, 0.04628152, 0.1835581, 0.5504162},
+	{488, 0.04115088, 0.1912735, 0.5203376},
+	{489, 0.03641283, 0.1994180, 0.4919673},
+	{490, 0.03201000, 0.2080200, 0.4651800},
+	{491, 0.02791720, 0.2171199, 0.4399246},
+	{492, 0.02414440, 0.2267345, 0.4161836},
+	{493, 0.02068700, 0.2368571, 0.3938822},
+	{494, 0.01754040, 0.2474812, 0.3729459},
+	{495, 0.01470000, 0.2586000, 0.3533000},
+	{496, 0.01216179, 0.2701849, 0.3348578},
+	{497, 0.009919960, 0.2822939, 0.3175521},
+	{498, 0.007967240, 0.2950505, 0.3013375},
+	{499, 0.006296346, 0.3085780, 0.2861686},
+	{500, 0.004900000, 0.3230000, 0.2720000},
+	{501, 0.003777173, 0.3384021, 0.2588171},
+	{502, 0.002945320, 0.3546858, 0.2464838},
+	{503, 0.002424880, 0.3716986, 0.2347718},
+	{504, 0.002236293, 0.3892875, 0.2234533},
+	{505, 0.002400000, 0.4073000, 0.2123000},
+	{506, 0.002925520, 0.4256299, 0.2011692},
+	{507, 0.003836560, 0.4443096, 0.1901196},
+	{508, 0.005174840, 0.4633944, 0.1792254},
+	{509, 0.006982080, 0.4829395, 0.1685608},
+	{510, 0.009300000, 0.5030000, 0.1582000},
+	{511, 0.01214949, 0.5235693, 0.1481383},
+	{512, 0.01553588, 0.5445120, 0.1383758},
+	{513, 0.01947752, 0.5656900, 0.1289942},
+	{514, 0.02399277, 0.5869653, 0.1200751},
+	{515, 0.02910000, 0.6082000, 0.1117000},
+	{516, 0.03481485, 0.6293456, 0.1039048},
+	{517, 0.04112016, 0.6503068, 0.09666748},
+	{518, 0.04798504, 0.6708752, 0.08998272},
+	{519, 0.05537861, 0.6908424, 0.08384531},
+	{520, 0.06327000, 0.7100000, 0.07824999},
+	{521, 0.07163501, 0.7281852, 0.07320899},
+	{522, 0.08046224, 0.7454636, 0.06867816},
+	{523, 0.08973996, 0.7619694, 0.06456784},
+	{524, 0.09945645, 0.7778368, 0.06078835},
+	{525, 0.1096000, 0.7932000, 0.05725001},
+	{526, 0.1201674, 0.8081104, 0.05390435},
+	{527, 0.1311145, 0.8224962, 0.05074664},
+	{528, 0.1423679, 0.8363068, 0.04775276},
+	{529, 0.1538542, 0.8494916, 0.04489859},
+	{530, 0.1655000, 0.8620000, 0.04216000},
+	{531, 0.1772571, 0.8738108, 0.03950728},
+	{532, 0.1891400, 0.8849624, 0.03693564},
+	{533, 0.2011694, 0.8954936, 0.03445836},
+	{534, 0.2133658, 0.9054432, 0.03208872},
+	{535, 0.2257499, 0.9148501, 0.02984000},
+	{536, 0.2383209, 0.9237348, 0.02771181},
+	{537, 0.2510668, 0.9320924, 0.02569444},
+	{538, 0.2639922, 0.9399226, 0.02378716},
+	{539, 0.2771017, 0.9472252, 0.02198925},
+	{540, 0.2904000, 0.9540000, 0.02030000},
+	{541, 0.3038912, 0.9602561, 0.01871805},
+	{542, 0.3175726, 0.9660074, 0.01724036},
+	{543, 0.3314384, 0.9712606, 0.01586364},
+	{544, 0.3454828, 0.9760225, 0.01458461},
+	{545, 0.3597000, 0.9803000, 0.01340000},
+	{546, 0.3740839, 0.9840924, 0.01230723},
+	{547, 0.3886396, 0.9874182, 0.01130188},
+	{548, 0.4033784, 0.9903128, 0.01037792},
+	{549, 0.4183115, 0.9928116, 0.009529306},
+	{550, 0.4334499, 0.9949501, 0.008749999},
+	{551, 0.4487953, 0.9967108, 0.008035200},
+	{552, 0.4643360, 0.9980983, 0.007381600},
+	{553, 0.4800640, 0.9991120, 0.006785400},
+	{554, 0.4959713, 0.9997482, 0.006242800},
+	{555, 0.5120501, 1.0000000, 0.005749999},
+	{556, 0.5282959, 0.9998567, 0.005303600},
+	{557, 0.5446916, 0.9993046, 0.004899800},
+	{558, 0.5612094, 0.9983255, 0.004534200},
+	{559, 0.5778215, 0.9968987, 0.004202400},
+	{560, 0.5945000, 0.9950000, 0.003900000},
+	{561, 0.6112209, 0.9926005, 0.003623200},
+	{562, 0.6279758, 0.9897426, 0.003370600},
+	{563, 0.6447602, 0.9864444, 0.003141400},
+	{564, 0.6615697, 0.9827241, 0.002934800},
+	{565, 0.6784000, 0.9786000, 0.002749999},
+	{566, 0.6952392, 0.9740837, 0.002585200},
+	{567, 0.7120586, 0.9691712, 0.002438600},
+	{568, 0.7288284, 0.9638568, 0.002309400},
+	{569, 0.7455188, 0.9581349, 0.002196800},
+	{570, 0.7621000, 0.9520000, 0.002100000},
+	{571, 0.7785432, 0.9454504, 0.002017733},
+	{572, 0.7948256, 0.9384992, 0.001948200},
+	{573, 0.8109264, 0.9311628, 0.001889800},
+	{574, 0.8268248, 0.9234576, 0.001840933},
+	{575, 0.8425000, 0.9154000, 0.001800000},
+	{576, 0.8579325, 0.9070064, 0.001766267},
+	{577, 0.8730816, 0.8982772, 0.001737800},
+	{578, 0.8878944, 0.8892048, 0.001711200},
+	{579, 0.9023181, 0.8797816, 0.001683067},
+	{580, 0.9163000, 0.8700000, 0.001650001},
+	{581, 0.9297995, 0.8598613, 0.001610133},
+	{582, 0.9427984, 0.8493920, 0.001564400},
+	{583, 0.9552776, 0.8386220, 0.001513600},
+	{584, 0.9672179, 0.8275813, 0.001458533},
+	{585, 0.9786000, 0.8163000, 0.001400000},
+	{586, 0.9893856, 0.8047947, 0.001336667},
+	{587, 0.9995488, 0.7930820, 0.001270000},
+	{588, 1.0090892, 0.7811920, 0.001205000},
+	{589, 1.0180064, 0.7691547, 0.001146667},
+	{590, 1.0263000, 0.7570000, 0.001100000},
+	{591, 1.0339827, 0.7447541, 0.001068800},
+	{592, 1.0409860, 0.7324224, 0.001049400},
+	{593, 1.0471880, 0.7200036, 0.001035600},
+	{594, 1.0524667, 0.7074965, 0.001021200},
+	{595, 1.0567000, 0.6949000, 0.001000000},
+	{596, 1.0597944, 0.6822192, 0.0009686400},
+	{597, 1.0617992, 0.6694716, 0.0009299200},
+	{598, 1.0628068, 0.6566744, 0.0008868800},
+	{599, 1.0629096, 0.6438448, 0.0008425600},
+	{600, 1.0622000, 0.6310000, 0.0008000000},
+	{601, 1.0607352, 0.6181555, 0.0007609600},
+	{602, 1.0584436, 0.6053144, 0.0007236800},
+	{603, 1.0552244, 0.5924756, 0.0006859200},
+	{604, 1.0509768, 0.5796379, 0.0006454400},
+	{605, 1.0456000, 0.5668000, 0.0006000000},
+	{606, 1.0390369, 0.5539611, 0.0005478667},
+	{607, 1.0313608, 0.5411372, 0.0004916000},
+	{608, 1.0226662, 0.5283528, 0.0004354000},
+	{609, 1.0130477, 0.5156323, 0.0003834667},
+	{610, 1.0026000, 0.5030000, 0.0003400000},
+	{611, 0.9913675, 0.4904688, 0.0003072533},
+	{612, 0.9793314, 0.4780304, 0.0002831600},
+	{613, 0.9664916, 0.4656776, 0.0002654400},
+	{614, 0.9528479, 0.4534032, 0.0002518133},
+	{615, 0.9384000, 0.4412000, 0.0002400000},
+	{616, 0.9231940, 0.4290800, 0.0002295467},
+	{617, 0.9072440, 0.4170360, 0.0002206400},
+	{618, 0.8905020, 0.4050320, 0.0002119600},
+	{619, 0.8729200, 0.3930320, 0.0002021867},
+	{620, 0.8544499, 0.3810000, 0.0001900000},
+	{621, 0.8350840, 0.3689184, 0.0001742133},
+	{622, 0.8149460, 0.3568272, 0.0001556400},
+	{623, 0.7941860, 0.3447768, 0.0001359600},
+	{624, 0.7729540, 0.3328176, 0.0001168533},
+	{625, 0.7514000, 0.3210000, 0.0001000000},
+	{626, 0.7295836, 0.3093381, 0.00008613333},
+	{627, 0.7075888, 0.2978504, 0.00007460000},
+	{628, 0.6856022, 0.2865936, 0.00006500000},
+	{629, 0.6638104, 0.2756245, 0.00005693333},
+	{630, 0.6424000, 0.2650000, 0.00004999999},
+	{631, 0.6215149, 0.2547632, 0.00004416000},
+	{632, 0.6011138, 0.2448896, 0.00003948000},
+	{633, 0.5811052, 0.2353344, 0.00003572000},
+	{634, 0.5613977, 0.2260528, 0.00003264000},
+	{635, 0.5419000, 0.2170000, 0.00003000000},
+	{636, 0.5225995, 0.2081616, 0.00002765333},
+	{637, 0.5035464, 0.1995488, 0.00002556000},
+	{638, 0.4847436, 0.1911552, 0.00002364000},
+	{639, 0.4661939, 0.1829744, 0.00002181333},
+	{640, 0.4479000, 0.1750000, 0.00002000000},
+	{641, 0.4298613, 0.1672235, 0.00001813333},
+	{642, 0.4120980, 0.1596464, 0.00001620000},
+	{643, 0.3946440, 0.1522776, 0.00001420000},
+	{644, 0.3775333, 0.1451259, 0.00001213333},
+	{645, 0.3608000, 0.1382000, 0.00001000000},
+	{646, 0.3444563, 0.1315003, 0.000007733333},
+	{647, 0.3285168, 0.1250248, 0.000005400000},
+	{648, 0.3130192, 0.1187792, 0.000003200000},
+	{649, 0.2980011, 0.1127691, 0.000001333333},
+	{650, 0.2835000, 0.1070000, 0.000000000000},
+	{651, 0.2695448, 0.1014762, 0.0},
+	{652, 0.2561184, 0.09618864, 0.0},
+	{653, 0.2431896, 0.09112296, 0.0},
+	{654, 0.2307272, 0.08626485, 0.0},
+	{655, 0.2187000, 0.08160000, 0.0},
+	{656, 0.2070971, 0.07712064, 0.0},
+	{657, 0.1959232, 0.07282552, 0.0},
+	{658, 0.1851708, 0.06871008, 0.0},
+	{659, 0.1748323, 0.06476976, 0.0},
+	{660, 0.1649000, 0.06100000, 0.0},
+	{661, 0.1553667, 0.05739621, 0.0},
+	{662, 0.1462300, 0.05395504, 0.0},
+	{663, 0.1374900, 0.05067376, 0.0},
+	{664, 0.1291467, 0.04754965, 0.0},
+	{665, 0.1212000, 0.04458000, 0.0},
+	{666, 0.1136397, 0.04175872, 0.0},
+	{667, 0.1064650, 0.03908496, 0.0},
+	{668, 0.09969044, 0.03656384, 0.0},
+	{669, 0.09333061, 0.03420048, 0.0},
+	{670, 0.08740000, 0.03200000, 0.0},
+	{671, 0.08190096, 0.02996261, 0.0},
+	{672, 0.07680428, 0.02807664, 0.0},
+	{673, 0.07207712, 0.02632936, 0.0},
+	{674, 0.06768664, 0.02470805, 0.0},
+	{675, 0.06360000, 0.02320000, 0.0},
+	{676, 0.05980685, 0.02180077, 0.0},
+	{677, 0.05628216, 0.02050112, 0.0},
+	{678, 0.05297104, 0.01928108, 0.0},
+	{679, 0.04981861, 0.01812069, 0.0},
+	{680, 0.04677000, 0.01700000, 0.000000000000},
+	{681, 0.04378405, 0.01590379, 0.0},
+	{682, 0.04087536, 0.01483718, 0.0},
+	{683, 0.03807264, 0.01381068, 0.0},
+	{684, 0.03540461, 0.01283478, 0.0},
+	{685, 0.03290000, 0.01192000, 0.0},
+	{686, 0.03056419, 0.01106831, 0.0},
+	{687, 0.02838056, 0.01027339, 0.0},
+	{688, 0.02634484, 0.009533311, 0.0},
+	{689, 0.02445275, 0.008846157, 0.0},
+	{690, 0.02270000, 0.008210000, 0.0},
+	{691, 0.02108429, 0.007623781, 0.0},
+	{692, 0.01959988, 0.007085424, 0.0},
+	{693, 0.01823732, 0.006591476, 0.0},
+	{694, 0.01698717, 0.006138485, 0.0},
+	{695, 0.01584000, 0.005723000, 0.0},
+	{696, 0.01479064, 0.005343059, 0.0},
+	{697, 0.01383132, 0.004995796, 0.0},
+	{698, 0.01294868, 0.004676404, 0.0},
+	{699, 0.01212920, 0.004380075, 0.0},
+	{700, 0.01135916, 0.004102000, 0.0},
+	{701, 0.01062935, 0.003838453, 0.0},
+	{702, 0.009938846, 0.003589099, 0.0},
+	{703, 0.009288422, 0.003354219, 0.0},
+	{704, 0.008678854, 0.003134093, 0.0},
+	{705, 0.008110916, 0.002929000, 0.0},
+	{706, 0.007582388, 0.002738139, 0.0},
+	{707, 0.007088746, 0.002559876, 0.0},
+	{708, 0.006627313, 0.002393244, 0.0},
+	{709, 0.006195408, 0.002237275, 0.0},
+	{710, 0.005790346, 0.002091000, 0.0},
+	{711, 0.005409826, 0.001953587, 0.0},
+	{712, 0.005052583, 0.001824580, 0.0},
+	{713, 0.004717512, 0.001703580, 0.0},
+	{714, 0.004403507, 0.001590187, 0.0},
+	{715, 0.004109457, 0.001484000, 0.0},
+	{716, 0.003833913, 0.001384496, 0.0},
+	{717, 0.003575748, 0.001291268, 0.0},
+	{718, 0.003334342, 0.001204092, 0.0},
+	{719, 0.003109075, 0.001122744, 0.0},
+	{720, 0.002899327, 0.001047000, 0.000000000000},
+	{721, 0.002704348, 0.0009765896, 0.0},
+	{722, 0.002523020, 0.0009111088, 0.0},
+	{723, 0.002354168, 0.0008501332, 0.0},
+	{724, 0.002196616, 0.0007932384, 0.0},
+	{725, 0.002049190, 0.0007400000, 0.0},
+	{726, 0.001910960, 0.0006900827, 0.0},
+	{727, 0.001781438, 0.0006433100, 0.0},
+	{728, 0.001660110, 0.0005994960, 0.0},
+	{729, 0.001546459, 0.0005584547, 0.0},
+	{730, 0.001439971, 0.0005200000, 0.0},
+	{731, 0.001340042, 0.0004839136, 0.0},
+	{732, 0.001246275, 0.0004500528, 0.0},
+	{733, 0.001158471, 0.0004183452, 0.0},
+	{734, 0.001076430, 0.0003887184, 0.0},
+	{735, 0.0009999493, 0.0003611000, 0.0},
+	{736, 0.0009287358, 0.0003353835, 0.0},
+	{737, 0.0008624332, 0.0003114404, 0.0},
+	{738, 0.0008007503, 0.0002891656, 0.0},
+	{739, 0.0007433960, 0.0002684539, 0.0},
+	{740, 0.0006900786, 0.0002492000, 0.0},
+	{741, 0.0006405156, 0.0002313019, 0.0},
+	{742, 0.0005945021, 0.0002146856, 0.0},
+	{743, 0.0005518646, 0.0001992884, 0.0},
+	{744, 0.0005124290, 0.0001850475, 0.0},
+	{745, 0.0004760213, 0.0001719000, 0.0},
+	{746, 0.0004424536, 0.0001597781, 0.0},
+	{747, 0.0004115117, 0.0001486044, 0.0},
+	{748, 0.0003829814, 0.0001383016, 0.0},
+	{749, 0.0003566491, 0.0001287925, 0.0},
+	{750, 0.0003323011, 0.0001200000, 0.0},
+	{751, 0.0003097586, 0.0001118595, 0.0},
+	{752, 0.0002888871, 0.0001043224, 0.0},
+	{753, 0.0002695394, 0.00009733560, 0.0},
+	{754, 0.0002515682, 0.00009084587, 0.0},
+	{755, 0.0002348261, 0.00008480000, 0.0},
+	{756, 0.0002191710, 0.00007914667, 0.0},
+	{757, 0.0002045258, 0.00007385800, 0.0},
+	{758, 0.0001908405, 0.00006891600, 0.0},
+	{759, 0.0001780654, 0.00006430267, 0.0},
+	{760, 0.0001661505, 0.00006000000, 0.000000000},
+	{761, 0.0001550236, 0.00005598187, 0.0},
+	{762, 0.0001446219, 0.00005222560, 0.0},
+	{763, 0.0001349098, 0.00004871840, 0.0},
+	{764, 0.0001258520, 0.00004544747, 0.0},
+	{765, 0.0001174130, 0.00004240000, 0.0},
+	{766, 0.0001095515, 0.00003956104, 0.0},
+	{767, 0.0001022245, 0.00003691512, 0.0},
+	{768, 0.00009539445, 0.00003444868, 0.0},
+	{769, 0.00008902390, 0.00003214816, 0.0},
+	{770, 0.00008307527, 0.00003000000, 0.0},
+	{771, 0.00007751269, 0.00002799125, 0.0},
+	{772, 0.00007231304, 0.00002611356, 0.0},
+	{773, 0.00006745778, 0.00002436024, 0.0},
+	{774, 0.00006292844, 0.00002272461, 0.0},
+	{775, 0.00005870652, 0.00002120000, 0.0},
+	{776, 0.00005477028, 0.00001977855, 0.0},
+	{777, 0.00005109918, 0.00001845285, 0.0},
+	{778, 0.00004767654, 0.00001721687, 0.0},
+	{779, 0.00004448567, 0.00001606459, 0.0},
+	{780, 0.00004150994, 0.00001499000, 0.0},
+	{781, 0.00003873324, 0.00001398728, 0.0},
+	{782, 0.00003614203, 0.00001305155, 0.0},
+	{783, 0.00003372352, 0.00001217818, 0.0},
+	{784, 0.00003146487, 0.00001136254, 0.0},
+	{785, 0.00002935326, 0.00001060000, 0.0},
+	{786, 0.00002737573, 0.000009885877, 0.0},
+	{787, 0.00002552433, 0.000009217304, 0.0},
+	{788, 0.00002379376, 0.000008592362, 0.0},
+	{789, 0.00002217870, 0.000008009133, 0.0},
+	{790, 0.00002067383, 0.000007465700, 0.0},
+	{791, 0.00001927226, 0.000006959567, 0.0},
+	{792, 0.00001796640, 0.000006487995, 0.0},
+	{793, 0.00001674991, 0.000006048699, 0.0},
+	{794, 0.00001561648, 0.000005639396, 0.0},
+	{795, 0.00001455977, 0.000005257800, 0.0},
+	{796, 0.00001357387, 0.000004901771, 0.0},
+	{797, 0.00001265436, 0.000004569720, 0.0},
+	{798, 0.00001179723, 0.000004260194, 0.0},
+	{799, 0.00001099844, 0.000003971739, 0.0},
+	{800, 0.00001025398, 0.000003702900, 0.000000000000},
+	{801, 0.000009559646, 0.000003452163, 0.0},
+	{802, 0.000008912044, 0.000003218302, 0.0},
+	{803, 0.000008308358, 0.000003000300, 0.0},
+	{804, 0.000007745769, 0.000002797139, 0.0},
+	{805, 0.000007221456, 0.000002607800, 0.0},
+	{806, 0.000006732475, 0.000002431220, 0.0},
+	{807, 0.000006276423, 0.000002266531, 0.0},
+	{808, 0.000005851304, 0.000002113013, 0.0},
+	{809, 0.000005455118, 0.000001969943, 0.0},
+	{810, 0.000005085868, 0.000001836600, 0.0},
+	{811, 0.000004741466, 0.000001712230, 0.0},
+	{812, 0.000004420236, 0.000001596228, 0.0},
+	{813, 0.000004120783, 0.000001488090, 0.0},
+	{814, 0.000003841716, 0.000001387314, 0.0},
+	{815, 0.000003581652, 0.000001293400, 0.0},
+	{816, 0.000003339127, 0.000001205820, 0.0},
+	{817, 0.000003112949, 0.000001124143, 0.0},
+	{818, 0.000002902121, 0.000001048009, 0.0},
+	{819, 0.000002705645, 0.0000009770578, 0.0},
+	{820, 0.000002522525, 0.0000009109300, 0.0},
+	{821, 0.000002351726, 0.0000008492513, 0.0},
+	{822, 0.000002192415, 0.0000007917212, 0.0},
+	{823, 0.000002043902, 0.0000007380904, 0.0},
+	{824, 0.000001905497, 0.0000006881098, 0.0},
+	{825, 0.000001776509, 0.0000006415300, 0.0},
+	{826, 0.000001656215, 0.0000005980895, 0.0},
+	{827, 0.000001544022, 0.0000005575746, 0.0},
+	{828, 0.000001439440, 0.0000005198080, 0.0},
+	{829, 0.000001341977, 0.0000004846123, 0.0},
+	{830, 0.000001251141, 0.0000004518100, 0.0}
+};
+const std::size_t color_matching_functions_size = sizeof(color_matching_functions)/sizeof(color_matching_functions[0]);
+
+namespace{
+
+void plot(Image& image, double x0, double y0, double x1, double y1, const Image::pixel_type& pixel)
+{
+	const double steps = std::max(std::max(std::fabs(x1 - x0), std::fabs(y1 - y0)), 1.0);
+	for(double i = 0.0; i <= steps; i += 1.0){
+		const double x = x0 + (x1 - x0)*i/steps;
+		const double y = y0 + (y1 - y0)*i/steps;
+		if(0.0 <= x && x < image.width() && 0.0 <= y && y < image.height()){
+			image[static_cast<row_t>(y)][static_cast<column_t>(x)] = pixel;
+		}
+	}
+}
+
+}
+
+ChromaticityDiagram::~ChromaticityDiagram(){}
+
+ChromaticityDiagram& ChromaticityDiagram::gamut(const Primaries& primaries, const Image::pixel_type& pixel)
+{
+	gamuts_.push_back(primaries);
+	colors_.push_back(pixel);
+	return *this;
+}
+
+Image& ChromaticityDiagram::generate(Image& image)const
+{
+	const column_t width  = image.width();
+	const row_t    height = image.height();
+	const double range_x = 0.8;
+	const double range_y = 0.9;
+	const double margin = std::min(width, height)/20.0;
+	const double scale = std::max(std::min((width - 2.0*margin)/range_x, (height - 2.0*margin)/range_y), 1.0);
+	const double left   = (width  - range_x*scale)/2.0;
+	const double bottom = (height + range_y*scale)/2.0;
+	const double right  = left + range_x*scale;
+	const double top    = bottom - range_y*scale;
+	const Image::pixel_type grid = white/8;
+
+	std::vector<double> locus_x(color_matching_functions_size);
+	std::vector<double> locus_y(color_matching_functions_size);
+	for(std::size_t i = 0; i < color_matching_functions_size; ++i){
+		const double* const cmf = color_matching_functions[i];
+		const double sum = cmf[1] + cmf[2] + cmf[3];
+		locus_x[i] = left   + cmf[1]/sum*scale;
+		locus_y[i] = bottom - cmf[2]/sum*scale;
+	}
+	std::vector<char> grid_columns(width, 0);
+	std::vector<char> grid_rows(height, 0);
+	for(int i = 0; i <= 8; ++i){
+		const double c = left + i*0.1*scale;
+		if(0.0 <= c && c < width){
+			grid_columns[static_cast<column_t>(c)] = 1;
+		}
+	}
+	for(int i = 0; i <= 9; ++i){
+		const double r = bottom - i*0.1*scale;
+		if(0.0 <= r && r < height){
+			grid_rows[static_cast<row_t>(r)] = 1;
+		}
+	}
+
+	Primaries::Matrix m;
+	Primaries::bt709().xyz_to_rgb(m);
+	const TransferFunction& srgb = TransferFunction::srgb();
+	const std::size_t vertices = locus_x.size();
+
+#pragma omp parallel
+	{
+		std::vector<double> crossings;
+#pragma omp for schedule(static)
+		for(row_t r = 0; r < height; ++r){
+			Image::pixel_type* const row = &image[r][0];
+			const bool inside = top <= r && r <= bottom;
+			for(column_t c = 0; c < width; ++c){
+				row[c] = inside && left <= c && c <= right && (grid_rows[r] || grid_columns[c]) ? grid : black;
+			}
+
+			const double py = r + 0.5;
+			crossings.clear();
+			for(std::size_t i = 0; i < vertices; ++i){
+				const std::size_t j = (i + 1)%vertices;
+				if((locus_y[i] <= py) != (locus_y[j] <= py)){
+					crossings.push_back(locus_x[i] + (py - locus_y[i])*(locus_x[j] - locus_x[i])/(locus_y[j] - locus_y[i]));
+				}
+			}
+			std::sort(crossings.begin(), crossings.end());
+
+			const double y = (bottom - py)/scale;
+			for(std::size_t i = 0; i + 1 < crossings.size(); i += 2){
+				const double first = std::max(std::ceil(crossings[i]     - 0.5), 0.0);
+				const double last  = std::min(std::ceil(crossings[i + 1] - 0.5), static_cast<double>(width));
+				for(column_t c = static_cast<column_t>(first); c < last; ++c){
+					const double x = (c + 0.5 - left)/scale;
+					const double xyz[3] = {x/y, 1.0, (1.0 - x - y)/y};
+					double rgb[3];
+					for(int k = 0; k < 3; ++k){
+						rgb[k] = m[k][0]*xyz[0] + m[k][1]*xyz[1] + m[k][2]*xyz[2];
+					}
+					const double minimum = std::min(0.0, std::min(rgb[0], std::min(rgb[1], rgb[2])));
+					const double maximum = std::max(rgb[0], std::max(rgb[1], rgb[2])) - minimum;
+					row[c] = Image::pixel_type(
+						srgb.encode(static_cast<float>((rgb[0] - minimum)/maximum)),
+						srgb.encode(static_cast<float>((rgb[1] - minimum)/maximum)),
+						srgb.encode(static_cast<float>((rgb[2] - minimum)/maximum)));
+				}
+			}
+		}
+	}
+
+	for(std::size_t i = 0; i < vertices; ++i){
+		const std::size_t j = (i + 1)%vertices;
+		plot(image, locus_x[i], locus_y[i], locus_x[j], locus_y[j], white);
+	}
+	for(std::size_t i = 0; i < gamuts_.size(); ++i){
+		const Primaries& p = gamuts_[i];
+		const double x[] = {p.red_x(), p.green_x(), p.blue_x()};
+		const double y[] = {p.red_y(), p.green_y(), p.blue_y()};
+		for(int k = 0; k < 3; ++k){
+			plot(image, left + x[k]*scale, bottom - y[k]*scale, left + x[(k + 1)%3]*scale, bottom - y[(k + 1)%3]*scale, colors_[i]);
+		}
+		const double wx = left + p.white_x()*scale;
+		const double wy = bottom - p.white_y()*scale;
+		plot(image, wx - 3.0, wy, wx + 3.0, wy, colors_[i]);
+		plot(image, wx, wy - 3.0, wx, wy + 3.0, colors_[i]);
+	}
+	return image;
+}
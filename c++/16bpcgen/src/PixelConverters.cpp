@@ -1,6 +1,53 @@
+#include <algorithm>
+#include <map>
 #include <stdexcept>
+#include <typeinfo>
+#include <utility>
 #include "Image.hpp"
 #include "PixelConverters.hpp"
+#include "TransferFunction.hpp"
+
+namespace{
+
+const std::size_t gamma_table_size = 0x10000;
+
+/**
+ * Gamma が参照する共有テーブル。要素を 32bit に広げておくと convert_span() の
+ * テーブル引きが gather 命令でベクトル化される。作ったテーブルは解放しない。
+ */
+const uint32_t* shared_gamma_table(const TransferFunction& tf, Gamma::Direction direction)
+{
+	typedef std::map<std::pair<int, double>, std::vector<uint32_t> > Tables;
+	static Tables tables;
+	const Tables::key_type key(tf.type()*2 + direction, tf.type() == TransferFunction::TF_POWER ? tf.gamma() : 0.0);
+	const uint32_t* table;
+#pragma omp critical(shared_gamma_table)
+	{
+		std::vector<uint32_t>& entry = tables[key];
+		if(entry.empty()){
+			entry.resize(gamma_table_size);
+			for(std::size_t v = 0; v < gamma_table_size; ++v){
+				const double code = static_cast<double>(v)/Image::pixel_type::max;
+				const double converted = direction == Gamma::DECODE ? tf.to_linear(code) : tf.from_linear(code);
+				entry[v] = static_cast<uint32_t>(std::min(converted*Image::pixel_type::max + 0.5, static_cast<double>(Image::pixel_type::max)));
+			}
+		}
+		table = &entry[0];
+	}
+	return table;
+}
+
+/**
+ * converter の動的な型が Converter そのものなら真。各 convert_span() は偽のとき(convert() だけを
+ * 上書きした派生クラスのとき)は独自のループを使わず、convert() を呼ぶ PixelConverter::convert_span() に任せる。
+ */
+template <typename Converter>
+bool exact_type(const Converter& converter)
+{
+	return typeid(converter) == typeid(Converter);
+}
+
+}
 
 Image::pixel_type& Channel::convert(Image::pixel_type& pixel)const
 {
@@ -16,6 +63,29 @@ Image::pixel_type& Channel::convert(Image::pixel_type& pixel)const
 	return pixel;
 }
 
+/**
+ * 以下の convert_span() は 1 行分の値を生ポインタで回し、チャンネルの指定はループの外で
+ * チャンネルごとの定数に畳んでおく。分岐のないループになるのでベクトル化される。
+ */
+void Channel::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	const Image::pixel_type::value_type keep[] = {
+		static_cast<Image::pixel_type::value_type>(ch_ & R ? Image::pixel_type::max : 0),
+		static_cast<Image::pixel_type::value_type>(ch_ & G ? Image::pixel_type::max : 0),
+		static_cast<Image::pixel_type::value_type>(ch_ & B ? Image::pixel_type::max : 0)};
+	Image::pixel_type::value_type* const values = reinterpret_cast<Image::pixel_type::value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	for(std::size_t i = 0; i < count; ++i){
+		values[i*3 + 0] &= keep[0];
+		values[i*3 + 1] &= keep[1];
+		values[i*3 + 2] &= keep[2];
+	}
+}
+
 Image::pixel_type& GrayScale::convert(Image::pixel_type& pixel)const
 {
 	const int coefficient = 1024;
@@ -27,6 +97,15 @@ Image::pixel_type& GrayScale::convert(Image::pixel_type& pixel)const
 	return pixel = Image::pixel_type(Y, Y, Y);
 }
 
+void GrayScale::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	convert_each(*this, first, last);
+}
+
 Image::pixel_type& Threshold::convert(Image::pixel_type& pixel)const
 {
 	switch(ch()){
@@ -44,6 +123,41 @@ Image::pixel_type& Threshold::convert(Image::pixel_type& pixel)const
 	}
 }
 
+/**
+ * 判定するチャンネルを最初に決めておき、比較結果を 3 チャンネルに書き込む。
+ */
+void Threshold::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	typedef Image::pixel_type::value_type value_type;
+	std::size_t k;
+	switch(ch()){
+	case R:
+		k = 0;
+		break;
+	case G:
+		k = 1;
+		break;
+	case B:
+		k = 2;
+		break;
+	default:
+		throw std::invalid_argument(__func__ + std::string(": can not apply Threshold process. invalid channelspecification."));
+	}
+	const value_type full_scale = Image::pixel_type::max;
+	value_type* const values = reinterpret_cast<value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	for(std::size_t i = 0; i < count; ++i){
+		const value_type v = values[i*3 + k] < threshold_ ? 0 : full_scale;
+		values[i*3 + 0] = v;
+		values[i*3 + 1] = v;
+		values[i*3 + 2] = v;
+	}
+}
+
 Image::pixel_type& Offset::convert(Image::pixel_type& pixel)const
 {
 
@@ -62,6 +176,43 @@ Image::pixel_type& Offset::convert(Image::pixel_type& pixel)const
 	return pixel;
 }
 
+/**
+ * 飽和加減算を 16bit のまま min/max と加減算に分解する。
+ *   min(v, max - o) + o, max(v, o) - o
+ * int に広げないので 1 命令あたりの要素数が倍になる。
+ */
+void Offset::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	typedef Image::pixel_type::value_type value_type;
+	const value_type offset[] = {
+		static_cast<value_type>(ch() & R ? offset_ : 0),
+		static_cast<value_type>(ch() & G ? offset_ : 0),
+		static_cast<value_type>(ch() & B ? offset_ : 0)};
+	value_type* const values = reinterpret_cast<value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	if(invert_){
+		for(std::size_t i = 0; i < count; ++i){
+			values[i*3 + 0] = static_cast<value_type>(std::max(values[i*3 + 0], offset[0]) - offset[0]);
+			values[i*3 + 1] = static_cast<value_type>(std::max(values[i*3 + 1], offset[1]) - offset[1]);
+			values[i*3 + 2] = static_cast<value_type>(std::max(values[i*3 + 2], offset[2]) - offset[2]);
+		}
+	}else{
+		const value_type ceiling[] = {
+			static_cast<value_type>(Image::pixel_type::max - offset[0]),
+			static_cast<value_type>(Image::pixel_type::max - offset[1]),
+			static_cast<value_type>(Image::pixel_type::max - offset[2])};
+		for(std::size_t i = 0; i < count; ++i){
+			values[i*3 + 0] = static_cast<value_type>(std::min(values[i*3 + 0], ceiling[0]) + offset[0]);
+			values[i*3 + 1] = static_cast<value_type>(std::min(values[i*3 + 1], ceiling[1]) + offset[1]);
+			values[i*3 + 2] = static_cast<value_type>(std::min(values[i*3 + 2], ceiling[2]) + offset[2]);
+		}
+	}
+}
+
 Image::pixel_type& Reversal::convert(Image::pixel_type& pixel)const
 {
 	if(ch() & R){
@@ -76,24 +227,161 @@ Image::pixel_type& Reversal::convert(Image::pixel_type& pixel)const
 	return pixel;
 }
 
+void Reversal::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	const Image::pixel_type::value_type flip[] = {
+		static_cast<Image::pixel_type::value_type>(ch() & R ? Image::pixel_type::max : 0),
+		static_cast<Image::pixel_type::value_type>(ch() & G ? Image::pixel_type::max : 0),
+		static_cast<Image::pixel_type::value_type>(ch() & B ? Image::pixel_type::max : 0)};
+	Image::pixel_type::value_type* const values = reinterpret_cast<Image::pixel_type::value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	for(std::size_t i = 0; i < count; ++i){
+		values[i*3 + 0] ^= flip[0];
+		values[i*3 + 1] ^= flip[1];
+		values[i*3 + 2] ^= flip[2];
+	}
+}
+
 Gamma::Gamma(const std::vector<Image::pixel_type::value_type>& lut, Ch c):
-	Channel(c), lut_(lut)
+	Channel(c), owned_(lut.begin(), lut.end()), lut_(), identity_(shared_gamma_table(TransferFunction::linear(), DECODE))
 {
-	if(lut_.size() != static_cast<std::size_t>(Image::pixel_type::max + 1u)){
+	if(owned_.size() != gamma_table_size){
 		throw std::invalid_argument(__func__ + std::string(": can not apply Gamma process. too short lut."));
 	}
+	lut_ = &owned_[0];
+}
+
+Gamma::Gamma(const TransferFunction& tf, Direction direction, Ch c):
+	Channel(c), owned_(), lut_(shared_gamma_table(tf, direction)), identity_(shared_gamma_table(TransferFunction::linear(), DECODE))
+{
+}
+
+Gamma::Gamma(const Gamma& other):
+	Channel(other), owned_(other.owned_), lut_(owned_.empty() ? other.lut_ : &owned_[0]), identity_(other.identity_)
+{
 }
 
 Image::pixel_type& Gamma::convert(Image::pixel_type& pixel)const
 {
 	if(ch() & R){
-		pixel.R(lut_[pixel.R()]);
+		pixel.R(static_cast<Image::pixel_type::value_type>(lut_[pixel.R()]));
 	}
 	if(ch() & G){
-		pixel.G(lut_[pixel.G()]);
+		pixel.G(static_cast<Image::pixel_type::value_type>(lut_[pixel.G()]));
 	}
 	if(ch() & B){
-		pixel.G(lut_[pixel.B()]);
+		pixel.B(static_cast<Image::pixel_type::value_type>(lut_[pixel.B()]));
 	}
 	return pixel;
 }
+
+/**
+ * 対象外のチャンネルは恒等テーブルで引いて、分岐のない gather のループにする。
+ * 恒等テーブルは構築時に引いておき、行ごとに共有テーブルの排他区間に入らないようにする。
+ */
+void Gamma::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	const uint32_t* const r = ch() & R ? lut_ : identity_;
+	const uint32_t* const g = ch() & G ? lut_ : identity_;
+	const uint32_t* const b = ch() & B ? lut_ : identity_;
+	Image::pixel_type::value_type* const values = reinterpret_cast<Image::pixel_type::value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	for(std::size_t i = 0; i < count; ++i){
+		values[i*3 + 0] = static_cast<Image::pixel_type::value_type>(r[values[i*3 + 0]]);
+		values[i*3 + 1] = static_cast<Image::pixel_type::value_type>(g[values[i*3 + 1]]);
+		values[i*3 + 2] = static_cast<Image::pixel_type::value_type>(b[values[i*3 + 2]]);
+	}
+}
+
+Gamma::~Gamma(){}
+
+LookUpTable::LookUpTable(): lut_(3*size)
+{
+	for(std::size_t c = 0; c < 3; ++c){
+		for(std::size_t v = 0; v < size; ++v){
+			lut_[c*size + v] = static_cast<Image::pixel_type::value_type>(v);
+		}
+	}
+}
+
+LookUpTable::LookUpTable(const PixelConverter& converter): lut_()
+{
+	LookUpTable identity;
+	lut_.swap(identity.lut_);
+	*this >>= converter;
+}
+
+LookUpTable::LookUpTable(const LookUpTable& lut): PixelConverter(lut), lut_(lut.lut_){}
+
+LookUpTable::~LookUpTable(){}
+
+LookUpTable LookUpTable::operator>>(const PixelConverter& converter)const
+{
+	LookUpTable result(*this);
+	return result >>= converter;
+}
+
+/**
+ * 合成済みの出力を (R, G, B) の組として converter に通す。separable なら各チャンネルの
+ * 出力はそのチャンネルの値だけで決まるので、3 チャンネル分を 65536 回の呼び出しで得られる。
+ */
+LookUpTable& LookUpTable::operator>>=(const PixelConverter& converter)
+{
+	if(!converter.separable()){
+		throw std::invalid_argument(__func__ + std::string(": can not compose lookup table. converter is not separable."));
+	}
+	Image::pixel_type::value_type* const r = &lut_[0*size];
+	Image::pixel_type::value_type* const g = &lut_[1*size];
+	Image::pixel_type::value_type* const b = &lut_[2*size];
+	const LookUpTable* const other = dynamic_cast<const LookUpTable*>(&converter);
+	if(other){
+		const Image::pixel_type::value_type* const tr = other->table(0);
+		const Image::pixel_type::value_type* const tg = other->table(1);
+		const Image::pixel_type::value_type* const tb = other->table(2);
+		for(std::size_t v = 0; v < size; ++v){
+			r[v] = tr[r[v]];
+			g[v] = tg[g[v]];
+			b[v] = tb[b[v]];
+		}
+		return *this;
+	}
+	for(std::size_t v = 0; v < size; ++v){
+		Image::pixel_type pixel(r[v], g[v], b[v]);
+		converter.convert(pixel);
+		r[v] = pixel.R();
+		g[v] = pixel.G();
+		b[v] = pixel.B();
+	}
+	return *this;
+}
+
+Image::pixel_type& LookUpTable::convert(Image::pixel_type& pixel)const
+{
+	return pixel = Image::pixel_type(lut_[0*size + pixel.R()], lut_[1*size + pixel.G()], lut_[2*size + pixel.B()]);
+}
+
+void LookUpTable::convert_span(Image::pixel_type* first, Image::pixel_type* last)const
+{
+	if(!exact_type(*this)){
+		PixelConverter::convert_span(first, last);
+		return;
+	}
+	const Image::pixel_type::value_type* const r = &lut_[0*size];
+	const Image::pixel_type::value_type* const g = &lut_[1*size];
+	const Image::pixel_type::value_type* const b = &lut_[2*size];
+	Image::pixel_type::value_type* const values = reinterpret_cast<Image::pixel_type::value_type*>(first);
+	const std::size_t count = static_cast<std::size_t>(last - first);
+	for(std::size_t i = 0; i < count; ++i){
+		values[i*3 + 0] = r[values[i*3 + 0]];
+		values[i*3 + 1] = g[values[i*3 + 1]];
+		values[i*3 + 2] = b[values[i*3 + 2]];
+	}
+}
@@ -0,0 +1,132 @@
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include "Primaries.hpp"
+
+namespace{
+
+const Primaries::Matrix bradford = {
+	{ 0.8951,  0.2664, -0.1614},
+	{-0.7502,  1.7135,  0.0367},
+	{ 0.0389, -0.0685,  1.0296}};
+
+void multiply(const Primaries::Matrix& a, const Primaries::Matrix& b, Primaries::Matrix& result)
+{
+	Primaries::Matrix m;
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			m[i][j] = a[i][0]*b[0][j] + a[i][1]*b[1][j] + a[i][2]*b[2][j];
+		}
+	}
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			result[i][j] = m[i][j];
+		}
+	}
+}
+
+void invert(const Primaries::Matrix& a, Primaries::Matrix& result)
+{
+	const double det =
+		a[0][0]*(a[1][1]*a[2][2] - a[1][2]*a[2][1]) -
+		a[0][1]*(a[1][0]*a[2][2] - a[1][2]*a[2][0]) +
+		a[0][2]*(a[1][0]*a[2][1] - a[1][1]*a[2][0]);
+	if(!(std::fabs(det) > 0.0)){
+		throw std::invalid_argument(__func__ + std::string(": can not invert matrix. primaries are degenerate."));
+	}
+	Primaries::Matrix m;
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			const int i1 = (j + 1)%3, i2 = (j + 2)%3;
+			const int j1 = (i + 1)%3, j2 = (i + 2)%3;
+			m[i][j] = (a[i1][j1]*a[i2][j2] - a[i1][j2]*a[i2][j1])/det;
+		}
+	}
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			result[i][j] = m[i][j];
+		}
+	}
+}
+
+void xyz(double x, double y, double* result)
+{
+	result[0] = x/y;
+	result[1] = 1.0;
+	result[2] = (1.0 - x - y)/y;
+}
+
+}
+
+Primaries::Primaries(double rx, double ry, double gx, double gy, double bx, double by, double wx, double wy)
+{
+	if(!(0.0 < ry && 0.0 < gy && 0.0 < by && 0.0 < wy)){
+		throw std::invalid_argument(__func__ + std::string(": can not create primaries. y must be positive."));
+	}
+	r_[0] = rx; r_[1] = ry;
+	g_[0] = gx; g_[1] = gy;
+	b_[0] = bx; b_[1] = by;
+	w_[0] = wx; w_[1] = wy;
+}
+
+const Primaries& Primaries::bt709()     {static const Primaries p(0.640, 0.330, 0.300, 0.600, 0.150, 0.060, 0.3127, 0.3290); return p;}
+const Primaries& Primaries::dci_p3()    {static const Primaries p(0.680, 0.320, 0.265, 0.690, 0.150, 0.060, 0.3140, 0.3510); return p;}
+const Primaries& Primaries::display_p3(){static const Primaries p(0.680, 0.320, 0.265, 0.690, 0.150, 0.060, 0.3127, 0.3290); return p;}
+const Primaries& Primaries::bt2020()    {static const Primaries p(0.708, 0.292, 0.170, 0.797, 0.131, 0.046, 0.3127, 0.3290); return p;}
+
+void Primaries::rgb_to_xyz(Matrix& m)const
+{
+	double r[3], g[3], b[3], w[3];
+	xyz(r_[0], r_[1], r);
+	xyz(g_[0], g_[1], g);
+	xyz(b_[0], b_[1], b);
+	xyz(w_[0], w_[1], w);
+	const Matrix p = {
+		{r[0], g[0], b[0]},
+		{r[1], g[1], b[1]},
+		{r[2], g[2], b[2]}};
+	Matrix inverse;
+	invert(p, inverse);
+	for(int i = 0; i < 3; ++i){
+		const double s = inverse[i][0]*w[0] + inverse[i][1]*w[1] + inverse[i][2]*w[2];
+		for(int j = 0; j < 3; ++j){
+			m[j][i] = p[j][i]*s;
+		}
+	}
+}
+
+void Primaries::xyz_to_rgb(Matrix& m)const
+{
+	rgb_to_xyz(m);
+	invert(m, m);
+}
+
+void Primaries::adaptation_from(const Primaries& white, Matrix& m)const
+{
+	double source[3], destination[3];
+	xyz(white.w_[0], white.w_[1], source);
+	xyz(w_[0], w_[1], destination);
+	double cone_source[3], cone_destination[3];
+	for(int i = 0; i < 3; ++i){
+		cone_source[i]      = bradford[i][0]*source[0]      + bradford[i][1]*source[1]      + bradford[i][2]*source[2];
+		cone_destination[i] = bradford[i][0]*destination[0] + bradford[i][1]*destination[1] + bradford[i][2]*destination[2];
+	}
+	Matrix scale = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+	for(int i = 0; i < 3; ++i){
+		scale[i][i] = cone_destination[i]/cone_source[i];
+	}
+	Matrix inverse;
+	invert(bradford, inverse);
+	multiply(scale, bradford, m);
+	multiply(inverse, m, m);
+}
+
+void Primaries::conversion_from(const Primaries& source, Matrix& m)const
+{
+	Matrix to_xyz, from_xyz, adaptation;
+	source.rgb_to_xyz(to_xyz);
+	xyz_to_rgb(from_xyz);
+	adaptation_from(source, adaptation);
+	multiply(adaptation, to_xyz, m);
+	multiply(from_xyz, m, m);
+}
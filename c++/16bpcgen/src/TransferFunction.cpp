@@ -0,0 +1,153 @@
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include "TransferFunction.hpp"
+
+namespace{
+
+const double pq_m1 = 2610.0/16384.0;
+const double pq_m2 = 2523.0/4096.0*128.0;
+const double pq_c1 = 3424.0/4096.0;
+const double pq_c2 = 2413.0/4096.0*32.0;
+const double pq_c3 = 2392.0/4096.0*32.0;
+
+const double hlg_a = 0.17883277;
+const double hlg_b = 1.0 - 4.0*hlg_a;
+const double hlg_c = 0.5 - hlg_a*std::log(4.0*hlg_a);
+
+/**
+ * 符号化テーブルは float の正規化数の範囲 [2^-126, 1.0) を 1 オクターブあたり 2^7 区間に分割する。
+ * 区間番号は float のビット列を右シフトしただけの値になる。
+ */
+const int      encode_mantissa_bits = 7;
+const int      encode_shift         = 23 - encode_mantissa_bits;
+const uint32_t encode_mask          = (1u << encode_shift) - 1u;
+const uint32_t encode_min_exponent  = 1u;
+const uint32_t encode_octaves       = 127u - encode_min_exponent;
+const uint32_t encode_base          = encode_min_exponent << encode_mantissa_bits;
+
+uint32_t float_bits(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+float bits_float(uint32_t bits)
+{
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+}
+
+TransferFunction::TransferFunction(Type type, double a_gamma):
+	type_(type), gamma_(type == TF_BT1886 ? 2.4 : a_gamma), decode_(Pixel<>::max + 1u),
+	encode_((encode_octaves << encode_mantissa_bits) + 1u), encode_zero_()
+{
+	if(type_ == TF_POWER && !(0.0 < gamma_)){
+		throw std::invalid_argument(__func__ + std::string(": can not create transfer function. gamma must be positive."));
+	}
+	for(std::size_t i = 0; i < decode_.size(); ++i){
+		decode_[i] = static_cast<float>(to_linear(static_cast<double>(i)/Pixel<>::max));
+	}
+	for(uint32_t i = 0; i < encode_.size(); ++i){
+		const float node = bits_float((encode_base + i) << encode_shift);
+		encode_[i] = static_cast<float>(from_linear(static_cast<double>(node))*Pixel<>::max);
+	}
+	encode_zero_ = static_cast<float>(from_linear(0.0)*Pixel<>::max);
+}
+
+TransferFunction::TransferFunction(const TransferFunction& tf):
+	type_(tf.type_), gamma_(tf.gamma_), decode_(tf.decode_), encode_(tf.encode_), encode_zero_(tf.encode_zero_)
+{
+}
+
+TransferFunction::~TransferFunction(){}
+
+const TransferFunction& TransferFunction::linear(){static const TransferFunction tf(TF_LINEAR); return tf;}
+const TransferFunction& TransferFunction::srgb()  {static const TransferFunction tf(TF_SRGB);   return tf;}
+const TransferFunction& TransferFunction::bt1886(){static const TransferFunction tf(TF_BT1886); return tf;}
+const TransferFunction& TransferFunction::pq()    {static const TransferFunction tf(TF_PQ);     return tf;}
+const TransferFunction& TransferFunction::hlg()   {static const TransferFunction tf(TF_HLG);    return tf;}
+
+const TransferFunction& TransferFunction::power(double gamma)
+{
+	if(!(0.0 < gamma)){
+		throw std::invalid_argument(__func__ + std::string(": can not create transfer function. gamma must be positive."));
+	}
+	static std::map<double, TransferFunction> functions;
+	const TransferFunction* tf;
+#pragma omp critical(transfer_function_power)
+	{
+		std::map<double, TransferFunction>::iterator i = functions.find(gamma);
+		if(i == functions.end()){
+			i = functions.insert(std::make_pair(gamma, TransferFunction(TF_POWER, gamma))).first;
+		}
+		tf = &i->second;
+	}
+	return *tf;
+}
+
+double TransferFunction::to_linear(double code)const
+{
+	const double v = std::min(std::max(code, 0.0), 1.0);
+	switch(type_){
+	case TF_LINEAR:
+		return v;
+	case TF_POWER:
+	case TF_BT1886:
+		return std::pow(v, gamma_);
+	case TF_SRGB:
+		return v <= 0.04045 ? v/12.92 : std::pow((v + 0.055)/1.055, 2.4);
+	case TF_PQ:{
+		const double p = std::pow(v, 1.0/pq_m2);
+		return std::pow(std::max(p - pq_c1, 0.0)/(pq_c2 - pq_c3*p), 1.0/pq_m1);
+	}
+	case TF_HLG:
+		return v <= 0.5 ? v*v/3.0 : (std::exp((v - hlg_c)/hlg_a) + hlg_b)/12.0;
+	default:
+		throw std::runtime_error(__func__ + std::string(": unknown transfer function."));
+	}
+}
+
+double TransferFunction::from_linear(double linear)const
+{
+	const double l = std::min(std::max(linear, 0.0), 1.0);
+	switch(type_){
+	case TF_LINEAR:
+		return l;
+	case TF_POWER:
+	case TF_BT1886:
+		return std::pow(l, 1.0/gamma_);
+	case TF_SRGB:
+		return l <= 0.0031308 ? l*12.92 : 1.055*std::pow(l, 1.0/2.4) - 0.055;
+	case TF_PQ:{
+		const double p = std::pow(l, pq_m1);
+		return std::pow((pq_c1 + pq_c2*p)/(1.0 + pq_c3*p), pq_m2);
+	}
+	case TF_HLG:
+		return l <= 1.0/12.0 ? std::sqrt(3.0*l) : hlg_a*std::log(12.0*l - hlg_b) + hlg_c;
+	default:
+		throw std::runtime_error(__func__ + std::string(": unknown transfer function."));
+	}
+}
+
+TransferFunction::value_type TransferFunction::encode(float linear)const
+{
+	const float minimum = bits_float(encode_base << encode_shift);
+	float code;
+	if(!(minimum <= linear)){
+		code = encode_zero_;
+	}else if(1.0f <= linear){
+		code = encode_[encode_.size() - 1];
+	}else{
+		const uint32_t bits = float_bits(linear);
+		const uint32_t index = (bits >> encode_shift) - encode_base;
+		const float fraction = static_cast<float>(bits & encode_mask)*(1.0f/static_cast<float>(encode_mask + 1u));
+		code = encode_[index] + (encode_[index + 1] - encode_[index])*fraction;
+	}
+	return static_cast<value_type>(std::min(code + 0.5f, static_cast<float>(Pixel<>::max)));
+}
@@ -8,55 +8,48 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include "Image.hpp"
+#include "LinearImage.hpp"
+#include "ImageProcesses.hpp"
 #include "PatternGenerators.hpp"
+#include "Primaries.hpp"
+#include "TransferFunction.hpp"
 #ifdef _WIN32
 #include <direct.h>
 #define mkdir(name, perm) _mkdir(name)
 #endif
 
+template <typename CS>
+class YCbCrPlane: public PatternGenerator{
+public:
+	virtual Image& generate(Image& image)const
+	{
+		typedef Image::pixel_type::value_type value_type;
+		const value_type y = Image::pixel_type::max/2;
+		for(row_t r = 0; r < image.height(); ++r){
+			const value_type cr = static_cast<value_type>(r*Image::pixel_type::max/image.height());
+			Image::pixel_type* const row = &image[image.height() - 1 - r][0];
+			for(column_t c = 0; c < image.width(); ++c){
+				const value_type cb = static_cast<value_type>(c*Image::pixel_type::max/image.width());
+				row[c] = Image::pixel_type::ycbcr_in_range(y, cb, cr) ? Image::pixel_type::ycbcr<CS>(y, cb, cr) : black;
+			}
+		}
+		return image;
+	}
+};
+
 int main(void)
 {
 	const column_t width  = 1024u;
 	const row_t    height = 1024u;
 	Image image(width, height);
-	typedef Image::pixel_type::value_type value_type;
 
 	mkdir("./img", 0755);
 
-	for(row_t r = 0; r < height; ++r){
-		for(column_t c = 0; c < width; ++c){
-			try{
-				Image::pixel_type p(Image::pixel_type::max/2, static_cast<value_type>(c*Image::pixel_type::max/width), static_cast<value_type>(r*Image::pixel_type::max/height), Image::pixel_type::CS_YCBCR_BT601);
-				image[height - 1 - r][c] = p;
-			}catch(const std::invalid_argument& err){
-				image[height - 1 - r][c] = black;
-			}
-		}
-	}
+	image <<= YCbCrPlane<BT601>();
 	image >> "./img/YCbCr601.png";
-
-	for(row_t r = 0; r < height; ++r){
-		for(column_t c = 0; c < width; ++c){
-			try{
-				Image::pixel_type p(Image::pixel_type::max/2, static_cast<value_type>(c*Image::pixel_type::max/width), static_cast<value_type>(r*Image::pixel_type::max/height), Image::pixel_type::CS_YCBCR_BT709);
-				image[height - 1 - r][c] = p;
-			}catch(const std::invalid_argument& err){
-				image[height - 1 - r][c] = black;
-			}
-		}
-	}
+	image <<= YCbCrPlane<BT709>();
 	image >> "./img/YCbCr709.png";
-
-	for(row_t r = 0; r < height; ++r){
-		for(column_t c = 0; c < width; ++c){
-			try{
-				Image::pixel_type p(Image::pixel_type::max/2, static_cast<value_type>(c*Image::pixel_type::max/width), static_cast<value_type>(r*Image::pixel_type::max/height), Image::pixel_type::CS_YCBCR_BT2020);
-				image[height - 1 - r][c] = p;
-			}catch(const std::invalid_argument& err){
-				image[height - 1 - r][c] = black;
-			}
-		}
-	}
+	image <<= YCbCrPlane<BT2020>();
 	image >> "./img/YCbCr2020.png";
 
 	image <<= Luster(black);
@@ -82,5 +75,23 @@ int main(void)
 		}
 	}
 	image2 >> "./img/HSV2.png";
+	image2 >> GamutMapping(Primaries::bt709(),  Primaries::bt2020(), TransferFunction::bt1886()) >> "./img/HSV2_BT709_in_BT2020.png";
+	image2 >> GamutMapping(Primaries::bt2020(), Primaries::bt709(),  TransferFunction::bt1886()) >> "./img/HSV2_BT2020_in_BT709.png";
+	image2 >> GamutMapping(Primaries::dci_p3(), Primaries::bt709(),  TransferFunction(TransferFunction::TF_POWER, 2.6)) >> "./img/HSV2_DCIP3_in_BT709.png";
+
+	const double nits[] = {0.0, 0.1, 1.0, 10.0, 100.0, 203.0, 1000.0, 4000.0, 10000.0};
+	const std::size_t steps = sizeof(nits)/sizeof(nits[0]);
+	LinearImage hdr(width2, height2);
+	for(row_t r = 0; r < height2; ++r){
+		LinearImage::value_type* const row = hdr[r];
+		for(column_t c = 0; c < width2; ++c){
+			const LinearImage::value_type level = r < height2/2
+				? static_cast<LinearImage::value_type>(nits[c*steps/width2]/10000.0)
+				: static_cast<LinearImage::value_type>(c)/static_cast<LinearImage::value_type>(width2 - 1);
+			row[c*3 + 0] = row[c*3 + 1] = row[c*3 + 2] = level;
+		}
+	}
+	hdr.encode(TransferFunction::pq())  >> "./img/PQ.png";
+	hdr.encode(TransferFunction::hlg()) >> "./img/HLG.png";
 	return 0;
 }
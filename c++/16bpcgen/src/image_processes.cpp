@@ -28,6 +28,11 @@ int main(void)
 	Image bit4 = orig & Image::pixel_type(0xf000, 0xf000, 0xf000);
 	Image bit3 = orig & Image::pixel_type(0xe000, 0xe000, 0xe000);
 
+	Image bayer     = orig >> Dither(3, Dither::BAYER);
+	Image bluenoise = orig >> Dither(3, Dither::BLUE_NOISE);
+	Image diffusion = orig >> Dither(3, Dither::FLOYD_STEINBERG);
+	Image binary    = orig >> Dither(1, Dither::FLOYD_STEINBERG);
+
 	Image normalize = orig >> Normalize();
 	Image median    = orig >> Median();
 	Image smoothing = orig >> WeightedSmoothing();
@@ -41,6 +46,7 @@ int main(void)
 	orig(r)(g)(b)
 		(gray(threshold)(offset)(reversal), Image::ORI_VERT)
 		(bit6(bit5)(bit4)(bit3), Image::ORI_VERT)
+		(bayer(bluenoise)(diffusion)(binary), Image::ORI_VERT)
 		(normalize(median)(smoothing)(unsharp), Image::ORI_VERT)
 		(prewitt(sobel)(laplacian1)(laplacian2), Image::ORI_VERT) >> "./img/image_processes.png";
 	return 0;
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include "Image.hpp"
+#include "ImageProcesses.hpp"
 #include "PatternGenerators.hpp"
 
 int main(int argc, char* argv[])
@@ -8,10 +9,11 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	Image img(argv[1]);
+	img >>= Dither(8);
 	for(row_t i = 0; i < img.height(); ++i){
 		for(column_t j = 0; j < img.width(); ++j){
 			const Pixel<>& p = img[i][j];
-			std::printf("\033[48;2;%d;%d;%dm  \033[49m", p.R()/256, p.G()/256, p.B()/256);
+			std::printf("\033[48;2;%d;%d;%dm  \033[49m", p.R() >> 8, p.G() >> 8, p.B() >> 8);
 		}
 		std::putchar('\n');
 	}
@@ -0,0 +1,57 @@
+#include <cmath>
+#include <iostream>
+#include "Image.hpp"
+#include "PatternGenerators.hpp"
+#include "Primaries.hpp"
+
+namespace{
+
+const column_t width  = 800;
+const row_t    height = 900;
+const double   scale  = 900.0;
+
+const Image::pixel_type& at(const Image& image, double x, double y)
+{
+	return image[static_cast<row_t>((height + 0.9*scale)/2.0 - y*scale)][static_cast<column_t>((width - 0.8*scale)/2.0 + x*scale)];
+}
+
+bool equal(const Image::pixel_type& lhs, const Image::pixel_type& rhs)
+{
+	return lhs.R() == rhs.R() && lhs.G() == rhs.G() && lhs.B() == rhs.B();
+}
+
+}
+
+int main(void)
+{
+	int failures = 0;
+	for(std::size_t i = 1; i < color_matching_functions_size; ++i){
+		if(std::fabs(color_matching_functions[i][0] - color_matching_functions[i - 1][0] - 1.0) > 0.0){
+			std::cerr << "color matching functions: wavelength " << color_matching_functions[i][0] << " is not continuous." << std::endl;
+			++failures;
+		}
+	}
+
+	Image image(width, height);
+	image <<= ChromaticityDiagram().gamut(Primaries::bt709(), red);
+	const Image::pixel_type& d65 = at(image, 0.3127, 0.3290);
+	if(!equal(d65, red)){
+		std::cerr << "white point of BT.709 is not marked." << std::endl;
+		++failures;
+	}
+	const Image::pixel_type& gray = at(image, 0.3127 + 0.005, 0.3290 + 0.005);
+	if(gray.R() < Image::pixel_type::max*9/10 || gray.G() < Image::pixel_type::max*9/10 || gray.B() < Image::pixel_type::max*9/10){
+		std::cerr << "color near the white point is not white." << std::endl;
+		++failures;
+	}
+	const Image::pixel_type& green_primary = at(image, 0.30, 0.60 - 0.01);
+	if(green_primary.G() != Image::pixel_type::max || Image::pixel_type::max/4 < green_primary.R() || Image::pixel_type::max/4 < green_primary.B()){
+		std::cerr << "color near the green primary is not green." << std::endl;
+		++failures;
+	}
+	if(!equal(at(image, 0.65, 0.65), black) || !equal(at(image, 0.12, 0.03), black)){
+		std::cerr << "outside of the spectral locus is not black." << std::endl;
+		++failures;
+	}
+	return failures;
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Image.hpp"
+#include "ImageProcesses.hpp"
+#include "PatternGenerators.hpp"
+#include "Random.hpp"
+
+namespace{
+
+typedef Image::pixel_type::value_type value_type;
+
+value_type level(unsigned int q, unsigned int maximum)
+{
+	return static_cast<value_type>((q*Image::pixel_type::max + maximum/2u)/maximum);
+}
+
+Image floyd_steinberg(const Image& image, byte_t bits)
+{
+	const unsigned int maximum = (1u << bits) - 1u;
+	const std::size_t stride = image.width()*3u;
+	Image result = image;
+	std::vector<int> errors((image.height() + 1)*(stride + 6u), 0);
+	for(row_t h = 0; h < image.height(); ++h){
+		value_type* const row = reinterpret_cast<value_type*>(&result[h][0]);
+		int* const current = &errors[h*(stride + 6u) + 3u];
+		int* const next = current + stride + 6u;
+		for(std::size_t k = 0; k < stride; ++k){
+			const int value = row[k] + current[k];
+			const int clamped = std::min(std::max(value, 0), static_cast<int>(Image::pixel_type::max));
+			const value_type q = level((static_cast<unsigned int>(clamped)*maximum + Image::pixel_type::max/2u)/Image::pixel_type::max, maximum);
+			const int error = value - q;
+			const int right = error*7/16, left = error*3/16, down = error*5/16;
+			row[k] = q;
+			if(k + 3 < stride){
+				current[k + 3] += right;
+			}
+			if(3 <= k){
+				next[k - 3] += left;
+			}
+			next[k] += down;
+			next[k + 3] += error - right - left - down;
+		}
+	}
+	return result;
+}
+
+int check_levels(const std::string& name, const Image& image, byte_t bits)
+{
+	const unsigned int maximum = (1u << bits) - 1u;
+	const value_type* const first = reinterpret_cast<const value_type*>(&image[0][0]);
+	const value_type* const last  = reinterpret_cast<const value_type*>(&image[image.height()][0]);
+	for(const value_type* p = first; p != last; ++p){
+		const unsigned int q = (*p*maximum + Image::pixel_type::max/2u)/Image::pixel_type::max;
+		if(*p != level(q, maximum)){
+			std::cerr << name << ": " << *p << " is not a " << static_cast<int>(bits) << " bit level." << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int check_mean(const std::string& name, Dither::Method method, byte_t bits, double tolerance)
+{
+	const unsigned int maximum = (1u << bits) - 1u;
+	int failures = 0;
+	for(unsigned int v = 0; v <= Image::pixel_type::max; v += 4099u){
+		Image image(128, 128);
+		image >>= Luster(Image::pixel_type(static_cast<value_type>(v), static_cast<value_type>(v), static_cast<value_type>(v)));
+		image >>= Dither(bits, method);
+		failures += check_levels(name, image, bits);
+		double sum = 0.0;
+		for(row_t h = 0; h < image.height(); ++h){
+			for(column_t w = 0; w < image.width(); ++w){
+				sum += image[h][w].G();
+			}
+		}
+		const double error = std::fabs(sum/(image.width()*image.height()) - v)*maximum/Image::pixel_type::max;
+		if(tolerance < error){
+			std::cerr << name << ": mean of " << v << " drifts " << error << " levels." << std::endl;
+			++failures;
+		}
+	}
+	return failures;
+}
+
+}
+
+int main(void)
+{
+	int failures = 0;
+	failures += check_mean("bayer",           Dither::BAYER,           8, 1.0/256.0);
+	failures += check_mean("blue noise",      Dither::BLUE_NOISE,      8, 1.0/4096.0);
+	failures += check_mean("blue noise 1bit", Dither::BLUE_NOISE,      1, 1.0/4096.0);
+	failures += check_mean("floyd-steinberg", Dither::FLOYD_STEINBERG, 4, 1.0/64.0);
+
+	const byte_t bits[] = {1, 8, 10, 15};
+	for(std::size_t i = 0; i < sizeof(bits)/sizeof(bits[0]); ++i){
+		Image image(301, 67);
+		noise(image, static_cast<unsigned int>(i) + 1u);
+		const Image expected = floyd_steinberg(image, bits[i]);
+		image >>= Dither(bits[i], Dither::FLOYD_STEINBERG);
+		if(!std::equal(image.head(), image.tail(), expected.head())){
+			std::cerr << "floyd-steinberg " << static_cast<int>(bits[i]) << "bit: result unmatch." << std::endl;
+			++failures;
+		}
+		Image ordered(301, 67);
+		noise(ordered, static_cast<unsigned int>(i) + 1u);
+		ordered >>= Dither(bits[i], Dither::BAYER);
+		failures += check_levels("bayer", ordered, bits[i]);
+	}
+
+	Image eight(256, 256);
+	for(row_t h = 0; h < eight.height(); ++h){
+		for(column_t w = 0; w < eight.width(); ++w){
+			const value_type v = static_cast<value_type>(h*256u + w);
+			eight[h][w] = Image::pixel_type(v, v, v);
+		}
+	}
+	eight >>= Dither(8, Dither::BAYER);
+	for(row_t h = 0; h < eight.height(); ++h){
+		for(column_t w = 0; w < eight.width(); ++w){
+			if(eight[h][w].R() != (eight[h][w].R() >> 8)*257){
+				std::cerr << "8bit level " << eight[h][w].R() << " is not byte replicated." << std::endl;
+				return failures + 1;
+			}
+		}
+	}
+	return failures;
+}
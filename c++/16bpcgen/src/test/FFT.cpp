@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "FFT.hpp"
+#include "Random.hpp"
+
+namespace{
+
+typedef FFT::complex_type complex_type;
+
+std::vector<complex_type> signal(std::size_t size, unsigned int seed)
+{
+	std::vector<complex_type> result(size);
+	for(std::size_t i = 0; i < size; ++i){
+		const double re = static_cast<double>(next_random(seed) >> 16)/65536.0 - 0.5;
+		const double im = static_cast<double>(next_random(seed) >> 16)/65536.0 - 0.5;
+		result[i] = complex_type(re, im);
+	}
+	return result;
+}
+
+std::vector<complex_type> dft(const std::vector<complex_type>& data, std::size_t stride, std::size_t size)
+{
+	const double pi = std::acos(-1.0);
+	std::vector<complex_type> result(size);
+	for(std::size_t k = 0; k < size; ++k){
+		for(std::size_t n = 0; n < size; ++n){
+			const double angle = -2.0*pi*static_cast<double>(k*n%size)/static_cast<double>(size);
+			result[k] += data[n*stride]*complex_type(std::cos(angle), std::sin(angle));
+		}
+	}
+	return result;
+}
+
+double difference(const std::vector<complex_type>& lhs, const std::vector<complex_type>& rhs)
+{
+	double result = 0.0;
+	for(std::size_t i = 0; i < lhs.size(); ++i){
+		result = std::max(result, std::abs(lhs[i] - rhs[i]));
+	}
+	return result;
+}
+
+}
+
+int main(void)
+{
+	int failures = 0;
+	for(std::size_t size = 1; size <= 256; size *= 2){
+		const FFT fft(size);
+		const std::vector<complex_type> original = signal(size, static_cast<unsigned int>(size));
+		std::vector<complex_type> data = original;
+		fft.transform(&data[0]);
+		if(1.0e-9 < difference(data, dft(original, 1, size))){
+			std::cerr << "size " << size << ": transform unmatch." << std::endl;
+			++failures;
+		}
+		fft.transform(&data[0], true);
+		for(std::size_t i = 0; i < size; ++i){
+			data[i] /= static_cast<double>(size);
+		}
+		if(1.0e-12 < difference(data, original)){
+			std::cerr << "size " << size << ": inverse transform unmatch." << std::endl;
+			++failures;
+		}
+	}
+
+	const std::size_t size = 32;
+	const FFT fft(size);
+	const std::vector<complex_type> original = signal(size*size, 3u);
+	std::vector<complex_type> expected(size*size), data = original, work;
+	for(std::size_t y = 0; y < size; ++y){
+		const std::vector<complex_type> line(original.begin() + static_cast<std::ptrdiff_t>(y*size), original.begin() + static_cast<std::ptrdiff_t>((y + 1)*size));
+		const std::vector<complex_type> transformed = dft(line, 1, size);
+		std::copy(transformed.begin(), transformed.end(), expected.begin() + static_cast<std::ptrdiff_t>(y*size));
+	}
+	for(std::size_t x = 0; x < size; ++x){
+		const std::vector<complex_type> column(expected.begin() + static_cast<std::ptrdiff_t>(x), expected.end());
+		const std::vector<complex_type> transformed = dft(column, size, size);
+		for(std::size_t y = 0; y < size; ++y){
+			expected[y*size + x] = transformed[y];
+		}
+	}
+	fft.transform2d(&data[0], work);
+	if(1.0e-9 < difference(data, expected)){
+		std::cerr << "2d transform unmatch." << std::endl;
+		++failures;
+	}
+
+	try{
+		FFT(12);
+		std::cerr << "size 12 is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
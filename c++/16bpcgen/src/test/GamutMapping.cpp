@@ -0,0 +1,107 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "Image.hpp"
+#include "ImageProcesses.hpp"
+#include "Primaries.hpp"
+#include "TransferFunction.hpp"
+#include "Random.hpp"
+
+namespace{
+
+typedef Image::pixel_type::value_type value_type;
+
+int check_matrix(const std::string& name, const Primaries::Matrix& m, const double (&expected)[3][3], double tolerance)
+{
+	for(int i = 0; i < 3; ++i){
+		for(int j = 0; j < 3; ++j){
+			if(tolerance < std::fabs(m[i][j] - expected[i][j])){
+				std::cerr << name << ": [" << i << "][" << j << "] = " << m[i][j] << ", expected " << expected[i][j] << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	const double bt709_to_xyz[3][3] = {
+		{0.4124, 0.3576, 0.1805},
+		{0.2126, 0.7152, 0.0722},
+		{0.0193, 0.1192, 0.9505}};
+	const double bt709_to_bt2020[3][3] = {
+		{0.6274, 0.3293, 0.0433},
+		{0.0691, 0.9195, 0.0114},
+		{0.0164, 0.0880, 0.8956}};
+	const double d65_to_d50[3][3] = {
+		{ 1.0479,  0.0229, -0.0502},
+		{ 0.0296,  0.9904, -0.0171},
+		{-0.0092,  0.0151,  0.7519}};
+	Primaries::Matrix m;
+	Primaries::bt709().rgb_to_xyz(m);
+	failures += check_matrix("BT.709 to XYZ", m, bt709_to_xyz, 1.0e-4);
+	Primaries::bt2020().conversion_from(Primaries::bt709(), m);
+	failures += check_matrix("BT.709 to BT.2020", m, bt709_to_bt2020, 1.0e-4);
+	const Primaries d50(0.64, 0.33, 0.30, 0.60, 0.15, 0.06, 0.3457, 0.3585);
+	d50.adaptation_from(Primaries::bt709(), m);
+	failures += check_matrix("D65 to D50", m, d65_to_d50, 1.0e-3);
+
+	const TransferFunction& tf = TransferFunction::bt1886();
+	Image image(256, 64);
+	noise(image);
+
+	Image wide = image;
+	wide >>= GamutMapping(Primaries::bt709(), Primaries::bt2020(), tf);
+	Image narrow = wide;
+	narrow >>= GamutMapping(Primaries::bt2020(), Primaries::bt709(), tf, false);
+	int roundtrip = 0;
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			const Image::pixel_type& p = image[h][w];
+			const Image::pixel_type& q = narrow[h][w];
+			const double error = std::max(std::fabs(tf.to_linear(p.R()/65535.0) - tf.to_linear(q.R()/65535.0)),
+				std::max(std::fabs(tf.to_linear(p.G()/65535.0) - tf.to_linear(q.G()/65535.0)),
+					std::fabs(tf.to_linear(p.B()/65535.0) - tf.to_linear(q.B()/65535.0))));
+			roundtrip += 1.0e-3 < error;
+		}
+	}
+	if(roundtrip){
+		std::cerr << "BT.709 -> BT.2020 -> BT.709: " << roundtrip << " pixels unmatch." << std::endl;
+		++failures;
+	}
+
+	const value_type low = tf.encode(0.05f);
+	Image primaries(3, 2);
+	primaries[0][0] = Image::pixel_type(Image::pixel_type::max, 0, 0);
+	primaries[0][1] = Image::pixel_type(0, Image::pixel_type::max, 0);
+	primaries[0][2] = Image::pixel_type(0, 0, Image::pixel_type::max);
+	primaries[1][0] = Image::pixel_type(Image::pixel_type::max, low, low);
+	primaries[1][1] = Image::pixel_type(low, Image::pixel_type::max, low);
+	primaries[1][2] = Image::pixel_type(low, low, Image::pixel_type::max);
+	Image clipped = primaries;
+	clipped >>= GamutMapping(Primaries::bt2020(), Primaries::bt709(), tf, false);
+	primaries >>= GamutMapping(Primaries::bt2020(), Primaries::bt709(), tf);
+	for(row_t h = 0; h < 2; ++h){
+		for(column_t w = 0; w < 3; ++w){
+			const value_type c[] = {primaries[h][w].R(), primaries[h][w].G(), primaries[h][w].B()};
+			const value_type d[] = {clipped[h][w].R(), clipped[h][w].G(), clipped[h][w].B()};
+			for(column_t k = 0; k < 3; ++k){
+				if(k == w && c[k] != Image::pixel_type::max){
+					std::cerr << "BT.2020 color " << h << ", " << w << ": lost its peak." << std::endl;
+					++failures;
+				}
+				if(k != w && (c[k] == 0 || c[k] < d[k])){
+					std::cerr << "BT.2020 color " << h << ", " << w << ": channel " << k << " is not compressed into BT.709." << std::endl;
+					++failures;
+				}
+			}
+		}
+	}
+	return failures;
+}
@@ -0,0 +1,1166 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Image.hpp"
+#include "ImageProcesses.hpp"
+#include "PatternGenerators.hpp"
+#include "PixelConverters.hpp"
+#include "Random.hpp"
+
+namespace{
+
+typedef Image::pixel_type::value_type value_type;
+
+value_type saturate(double value)
+{
+	const double rounded = std::floor(value + 0.5);
+	return static_cast<value_type>(rounded < 0.0 ? 0.0 : Image::pixel_type::max < rounded ? Image::pixel_type::max : rounded);
+}
+
+long outside(long i, long n, Filter::Border border)
+{
+	switch(border){
+	case Filter::BORDER_CLAMP:
+		return std::min(std::max(i, 0L), n - 1);
+	case Filter::BORDER_MIRROR:
+		while(1 < n && (i < 0 || n <= i)){
+			i = i < 0 ? -i : (n - 1)*2 - i;
+		}
+		return 1 < n ? i : 0;
+	case Filter::BORDER_WRAP:
+		return (i%n + n)%n;
+	case Filter::BORDER_CONSTANT:
+	default:
+		return 0 <= i && i < n ? i : -1;
+	}
+}
+
+Image convolve(const Image& image, const Filter::Kernel& kernel,
+		Filter::Border border = Filter::BORDER_CONSTANT, const Image::pixel_type& constant = black)
+{
+	Image result(image.width(), image.height());
+	const long height = static_cast<long>(image.height()), width = static_cast<long>(image.width());
+	const long size_h = static_cast<long>(kernel.size()), size_w = static_cast<long>(kernel[0].size());
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&result[0][0]);
+	const double fill[] = {static_cast<double>(constant.R()), static_cast<double>(constant.G()), static_cast<double>(constant.B())};
+	// Debug ビルドでも速く回るよう、画像の外の扱いは列ごとに先に求めておき、値は配列として直接読む。
+	std::vector<long> columns(static_cast<std::size_t>(width + size_w));
+	for(long j = 0; j < width + size_w; ++j){
+		columns[static_cast<std::size_t>(j)] = outside(j - size_w/2, width, border);
+	}
+	for(long h = 0; h < height; ++h){
+		for(long w = 0; w < width; ++w){
+			double sum[3] = {0.0, 0.0, 0.0};
+			for(long i = 0; i < size_h; ++i){
+				const long y = outside(h - size_h/2 + i, height, border);
+				const Filter::KernelRow& weights = kernel[static_cast<std::size_t>(i)];
+				for(long j = 0; j < size_w; ++j){
+					const long x = columns[static_cast<std::size_t>(w + j)];
+					const double weight = weights[static_cast<std::size_t>(j)];
+					const value_type* const p = y < 0 || x < 0 ? 0 : src + (y*width + x)*3;
+					for(int c = 0; c < 3; ++c){
+						sum[c] += (p ? p[c] : fill[c])*weight;
+					}
+				}
+			}
+			for(int c = 0; c < 3; ++c){
+				dst[(h*width + w)*3 + c] = saturate(sum[c]);
+			}
+		}
+	}
+	return result;
+}
+
+Image median(const Image& image, unsigned int radius, const Area& area)
+{
+	Image result = image;
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&result[0][0]);
+	std::vector<value_type> values;
+	for(row_t h = area.offset_y_; h < area.offset_y_ + area.height_; ++h){
+		for(column_t w = area.offset_x_; w < area.offset_x_ + area.width_; ++w){
+			for(int c = 0; c < 3; ++c){
+				values.clear();
+				for(row_t i = h < radius ? 0 : h - radius; i < std::min(h + radius + 1, image.height()); ++i){
+					for(column_t j = w < radius ? 0 : w - radius; j < std::min(w + radius + 1, image.width()); ++j){
+						values.push_back(src[(i*image.width() + j)*3 + static_cast<std::size_t>(c)]);
+					}
+				}
+				std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(values.size()/2), values.end());
+				dst[(h*image.width() + w)*3 + static_cast<std::size_t>(c)] = values[values.size()/2];
+			}
+		}
+	}
+	return result;
+}
+
+bool equal(const Image& lhs, const Image& rhs)
+{
+	return lhs.width() == rhs.width() && lhs.height() == rhs.height() && std::equal(lhs.head(), lhs.tail(), rhs.head());
+}
+
+Filter::Kernel kernel(const double* values, std::size_t size, double scale = 1.0)
+{
+	Filter::Kernel result(size, Filter::KernelRow(size));
+	for(std::size_t i = 0; i < size*size; ++i){
+		result[i/size][i%size] = values[i]*scale;
+	}
+	return result;
+}
+
+int expect_equal(const std::string& name, const Image& actual, const Image& expected)
+{
+	if(!equal(actual, expected)){
+		std::cerr << name << ": result unmatch." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+int max_difference(const Image& lhs, const Image& rhs)
+{
+	const value_type* const first = reinterpret_cast<const value_type*>(&lhs[0][0]);
+	const value_type* const second = reinterpret_cast<const value_type*>(&rhs[0][0]);
+	int result = 0;
+	for(std::size_t i = 0; i < lhs.width()*lhs.height()*3u; ++i){
+		result = std::max(result, std::abs(first[i] - second[i]));
+	}
+	return result;
+}
+
+int check(const std::string& name, const Image& image, const Filter::Kernel& k,
+		Filter::Border border = Filter::BORDER_CONSTANT, const Image::pixel_type& constant = black)
+{
+	return expect_equal(name, image >> Filter(k, border, constant), convolve(image, k, border, constant));
+}
+
+/**
+ * FFT で畳み込んだ結果は丸めの境目で 1 ずれることがある。
+ */
+int check_near(const std::string& name, const Image& image, const Filter::Kernel& k,
+		Filter::Border border = Filter::BORDER_CONSTANT, const Image::pixel_type& constant = black)
+{
+	const Image result = image >> Filter(k, border, constant), expected = convolve(image, k, border, constant);
+	if(1 < max_difference(result, expected)){
+		std::cerr << name << ": result unmatch." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+Filter::KernelRow gaussian_taps(double sigma)
+{
+	const int radius = static_cast<int>(std::ceil(sigma*4.0));
+	Filter::KernelRow taps;
+	double sum = 0.0;
+	for(int i = -radius; i <= radius; ++i){
+		taps.push_back(std::exp(-i*i/(sigma*sigma*2.0)));
+		sum += taps.back();
+	}
+	for(std::size_t i = 0; i < taps.size(); ++i){
+		taps[i] /= sum;
+	}
+	return taps;
+}
+
+int check_separable(const std::string& name, const Image& image, const Filter::KernelRow& row, const Filter::KernelRow& column,
+		Filter::Border border = Filter::BORDER_CONSTANT, const Image::pixel_type& constant = black)
+{
+	Filter::Kernel k(column.size(), row);
+	for(std::size_t i = 0; i < k.size(); ++i){
+		for(std::size_t j = 0; j < k[i].size(); ++j){
+			k[i][j] *= column[i];
+		}
+	}
+	return expect_equal(name, image >> SeparableFilter(row, column, border, constant), convolve(image, k, border, constant));
+}
+
+bool same(const Image::pixel_type& lhs, const Image::pixel_type& rhs)
+{
+	return lhs.R() == rhs.R() && lhs.G() == rhs.G() && lhs.B() == rhs.B();
+}
+
+Image transpose(const Image& image)
+{
+	Image result(image.height(), image.width());
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			result[w][h] = image[h][w];
+		}
+	}
+	return result;
+}
+
+/**
+ * 縦横とも 256 画素以上になるまで画像を敷き詰める。
+ */
+Image tile(const Image& image)
+{
+	Image result((255/image.width() + 1)*image.width(), (255/image.height() + 1)*image.height());
+	for(row_t h = 0; h < result.height(); ++h){
+		for(column_t w = 0; w < result.width(); ++w){
+			result[h][w] = image[h%image.height()][w%image.width()];
+		}
+	}
+	return result;
+}
+
+/**
+ * 敷き詰めた画像を周期境界で処理すると、結果も元の画像の結果を敷き詰めたものになる。敷き詰めた画像は
+ * tone_parallel_pixels を超えるので、並列の経路を参照実装と比べずに(小さな画像の結果を介して)確かめられる。
+ */
+int check_tiled(const std::string& name, const Image& image, const ImageProcess& process)
+{
+	return expect_equal(name, tile(image) >> process, tile(image >> process));
+}
+
+/**
+ * 印の画素(G が 0xdead)で invalid_argument を投げ、それ以外は R を 1 増やす。
+ */
+class Faulty: public PixelConverter{
+public:
+	virtual ~Faulty();
+	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+};
+
+Faulty::~Faulty(){}
+
+Image::pixel_type& Faulty::convert(Image::pixel_type& pixel)const
+{
+	if(pixel.G() == 0xdead){
+		throw std::invalid_argument("faulty: marked pixel.");
+	}
+	pixel.R(static_cast<value_type>(pixel.R() + 1));
+	return pixel;
+}
+
+/**
+ * 途中の行で変換が失敗したとき、元の例外がそのまま届き、どの画素も 2 度変換されていないかを確かめる。
+ */
+int check_tone_failure(const std::string& name, column_t width, row_t height, bool region)
+{
+	Image image(width, height);
+	image >>= Luster(black);
+	image[height/2][width/2] = Image::pixel_type(0, 0xdead, 0);
+	try{
+		if(region){
+			image >>= RegionTone(Faulty(), Region(width, height).add(Area(width/2, height, 0, 0)).add(Area(width - width/2 - 1, height, width/2 + 1, 0)).add(Area(1, height, width/2, 0)));
+		}else{
+			image >>= Tone(Faulty());
+		}
+		std::cerr << name << ": failure is not reported." << std::endl;
+		return 1;
+	}catch(const std::invalid_argument& e){
+		if(std::string(e.what()) != "faulty: marked pixel."){
+			std::cerr << name << ": exception message is lost: " << e.what() << std::endl;
+			return 1;
+		}
+	}catch(const std::exception& e){
+		std::cerr << name << ": exception type is lost: " << e.what() << std::endl;
+		return 1;
+	}
+	for(row_t h = 0; h < height; ++h){
+		for(column_t w = 0; w < width; ++w){
+			if(1 < image[h][w].R()){
+				std::cerr << name << ": pixel " << w << ", " << h << " is converted twice." << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * Resize::stream() の出力行を画像に写し、行が上から順に来たかを数える。
+ */
+class Collector: public Resize::Sink{
+public:
+	Collector(Image& image): image_(image), next_(0){}
+	virtual void write(row_t h, const Row& row);
+	row_t next()const{return next_;}
+private:
+	Image& image_;
+	row_t next_;
+};
+
+void Collector::write(row_t h, const Row& row)
+{
+	if(h == next_){
+		++next_;
+	}
+	for(column_t w = 0; w < row.width(); ++w){
+		image_[h][w] = row[w];
+	}
+}
+
+/**
+ * Warp の参照実装。出力の画素ごとに inverse を掛け直して、双線形で標本化する。
+ */
+Image warp(const Image& image, const Warp::Matrix& inverse, const Image::pixel_type& background)
+{
+	Image result(image.width(), image.height());
+	for(row_t h = 0; h < result.height(); ++h){
+		for(column_t w = 0; w < result.width(); ++w){
+			const double x = w + 0.5, y = h + 0.5;
+			const double z = inverse[2][0]*x + inverse[2][1]*y + inverse[2][2];
+			const double u = (inverse[0][0]*x + inverse[0][1]*y + inverse[0][2])/z - 0.5;
+			const double v = (inverse[1][0]*x + inverse[1][1]*y + inverse[1][2])/z - 0.5;
+			const long x0 = static_cast<long>(std::floor(u)), y0 = static_cast<long>(std::floor(v));
+			const double tx = u - std::floor(u), ty = v - std::floor(v);
+			double sum[3] = {0.0, 0.0, 0.0};
+			for(long j = 0; j < 2; ++j){
+				for(long i = 0; i < 2; ++i){
+					const double weight = (i ? tx : 1.0 - tx)*(j ? ty : 1.0 - ty);
+					const bool inside = 0 <= x0 + i && x0 + i < static_cast<long>(image.width()) && 0 <= y0 + j && y0 + j < static_cast<long>(image.height());
+					const Image::pixel_type& p = inside ? image[static_cast<row_t>(y0 + j)][static_cast<column_t>(x0 + i)] : background;
+					sum[0] += weight*p.R();
+					sum[1] += weight*p.G();
+					sum[2] += weight*p.B();
+				}
+			}
+			result[h][w] = Image::pixel_type(saturate(sum[0]), saturate(sum[1]), saturate(sum[2]));
+		}
+	}
+	return result;
+}
+
+/**
+ * 時計回りに quarter * 90 度回し、flip なら続けて左右を反転する。
+ */
+Image orient(const Image& image, int quarter, bool flip)
+{
+	const bool turned = quarter % 2;
+	Image result(turned ? image.height() : image.width(), turned ? image.width() : image.height());
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			column_t x = w;
+			row_t y = h;
+			switch(quarter){
+			case 1:
+				x = image.height() - 1 - h;
+				y = w;
+				break;
+			case 2:
+				x = image.width() - 1 - w;
+				y = image.height() - 1 - h;
+				break;
+			case 3:
+				x = h;
+				y = image.width() - 1 - w;
+				break;
+			default:
+				break;
+			}
+			result[y][flip ? result.width() - 1 - x : x] = image[h][w];
+		}
+	}
+	return result;
+}
+
+/**
+ * RemapTable のファイル original の position バイト目から bytes を書き換えた(bytes が空なら position で切り詰めた)ファイルが
+ * 読み込みで拒否されるかを確かめる。
+ */
+int check_corrupt(const std::string& name, const std::string& original, std::size_t position, const std::string& bytes)
+{
+	std::ifstream ifs(original.c_str(), std::ios::binary | std::ios::ate);
+	std::string content(static_cast<std::size_t>(ifs.tellg()), '\0');
+	ifs.seekg(0);
+	ifs.read(&content[0], static_cast<std::streamsize>(content.size()));
+	content = bytes.empty() ? content.substr(0, position) : content.replace(position, bytes.size(), bytes);
+	const std::string corrupt = original + ".corrupt";
+	std::ofstream(corrupt.c_str(), std::ios::binary).write(content.data(), static_cast<std::streamsize>(content.size()));
+	try{
+		RemapTable table(corrupt);
+		std::remove(corrupt.c_str());
+		std::cerr << name << ": corrupt table is accepted." << std::endl;
+		return 1;
+	}catch(const std::invalid_argument&){
+	}
+	std::remove(corrupt.c_str());
+	return 0;
+}
+
+/**
+ * 窓の中で基準点より前にある画素が before_w, before_h 個の最小(minimum)か最大を、画像の外を除いて求める。
+ */
+Image extremum(const Image& image, column_t size_w, row_t size_h, column_t before_w, row_t before_h, bool minimum)
+{
+	Image result(image.width(), image.height());
+	const long height = static_cast<long>(image.height()), width = static_cast<long>(image.width());
+	const value_type* const src = reinterpret_cast<const value_type*>(&image[0][0]);
+	value_type* const dst = reinterpret_cast<value_type*>(&result[0][0]);
+	for(long h = 0; h < height; ++h){
+		const long top = std::max(h - static_cast<long>(before_h), 0L), bottom = std::min(h - static_cast<long>(before_h) + static_cast<long>(size_h), height);
+		for(long w = 0; w < width; ++w){
+			const long left = std::max(w - static_cast<long>(before_w), 0L), right = std::min(w - static_cast<long>(before_w) + static_cast<long>(size_w), width);
+			for(long c = 0; c < 3; ++c){
+				value_type value = minimum ? Image::pixel_type::max : 0;
+				for(long y = top; y < bottom; ++y){
+					for(long x = left; x < right; ++x){
+						const value_type v = src[(y*width + x)*3 + c];
+						value = minimum ? std::min(value, v) : std::max(value, v);
+					}
+				}
+				dst[(h*width + w)*3 + c] = value;
+			}
+		}
+	}
+	return result;
+}
+
+Image erode(const Image& image, column_t size_w, row_t size_h)
+{
+	return extremum(image, size_w, size_h, size_w/2, size_h/2, true);
+}
+
+Image dilate(const Image& image, column_t size_w, row_t size_h)
+{
+	return extremum(image, size_w, size_h, size_w - 1 - size_w/2, size_h - 1 - size_h/2, false);
+}
+
+/**
+ * Gradient の参照実装。チャンネル c の画素 (w, h) の横と縦の微分を求める。
+ */
+void derivative(const Image& image, row_t h, column_t w, int c, int center, Filter::Border border, int& gx, int& gy)
+{
+	int values[3][3];
+	for(long j = 0; j < 3; ++j){
+		for(long i = 0; i < 3; ++i){
+			const long y = outside(static_cast<long>(h) + j - 1, static_cast<long>(image.height()), border);
+			const long x = outside(static_cast<long>(w) + i - 1, static_cast<long>(image.width()), border);
+			const Image::pixel_type& p = y < 0 || x < 0 ? black : image[static_cast<row_t>(y)][static_cast<column_t>(x)];
+			values[j][i] = c == 0 ? p.R() : c == 1 ? p.G() : p.B();
+		}
+	}
+	gx = (values[0][2] - values[0][0]) + center*(values[1][2] - values[1][0]) + (values[2][2] - values[2][0]);
+	gy = (values[2][0] + center*values[2][1] + values[2][2]) - (values[0][0] + center*values[0][1] + values[0][2]);
+}
+
+int check_operator(const std::string& name, const Image& image, Gradient::Operator op, Filter::Border border)
+{
+	const int center = op == Gradient::OPERATOR_SOBEL ? 2 : 1, divisor = center + 2;
+	const double pi = std::acos(-1.0);
+	std::vector<uint8_t> orientation;
+	const Image l1 = image >> Gradient(op, Gradient::NORM_L1, 0, border);
+	const Image l2 = image >> Gradient(op, Gradient::NORM_L2, &orientation, border);
+	const Image approximate = image >> Gradient(op, Gradient::NORM_APPROXIMATE, 0, border);
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			int best = -1, best_x = 0, best_y = 0;
+			for(int c = 0; c < 3; ++c){
+				int gx, gy;
+				derivative(image, h, w, c, center, border, gx, gy);
+				const int ax = std::abs(gx), ay = std::abs(gy);
+				const int expected_l1 = std::min((ax + ay + divisor/2)/divisor, 0xffff);
+				const int expected_approximate = std::min((std::max(ax, ay) + std::min(ax, ay)*3/8 + divisor/2)/divisor, 0xffff);
+				const double expected_l2 = std::min(std::sqrt(static_cast<double>(gx)*gx + static_cast<double>(gy)*gy)/divisor, 65535.0);
+				const value_type* const p1 = reinterpret_cast<const value_type*>(&l1[h][w]);
+				const value_type* const p2 = reinterpret_cast<const value_type*>(&l2[h][w]);
+				const value_type* const pa = reinterpret_cast<const value_type*>(&approximate[h][w]);
+				if(p1[c] != expected_l1 || 1.0 < std::fabs(p2[c] - expected_l2) || pa[c] != expected_approximate){
+					std::cerr << name << ": magnitude unmatch at " << w << ", " << h << "." << std::endl;
+					return 1;
+				}
+				if(best < ax + ay){
+					best = ax + ay;
+					best_x = gx;
+					best_y = gy;
+				}
+			}
+			const double angle = std::atan2(static_cast<double>(best_y), static_cast<double>(best_x))*180.0/pi;
+			const double folded = angle < 0.0 ? angle + 180.0 : angle;
+			const int expected = static_cast<int>(std::floor((folded + 22.5)/45.0))%4;
+			const double margin = std::fabs(std::fmod(folded + 22.5, 45.0) - 22.5);
+			if(best && margin < 22.0 && orientation[h*image.width() + w] != expected){
+				std::cerr << name << ": orientation unmatch at " << w << ", " << h << "." << std::endl;
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+const double sobel[] = {-1, -2, -1, 0, 0, 0, 1, 2, 1};
+const double laplacian[] = {
+	-1, -3, -4, -3, -1,
+	-3,  0,  6,  0, -3,
+	-4,  6, 20,  6, -4,
+	-3,  0,  6,  0, -3,
+	-1, -3, -4, -3, -1};
+const double smoothing[] = {
+	0, 0, 1, 0, 0,
+	0, 1, 1, 1, 0,
+	1, 1, 1, 1, 1,
+	0, 1, 1, 1, 0,
+	0, 0, 1, 0, 0};
+const double gaussian[] = {1, 2, 1, 2, 4, 2, 1, 2, 1};
+
+const Filter::Border borders[] = {Filter::BORDER_CONSTANT, Filter::BORDER_CLAMP, Filter::BORDER_MIRROR, Filter::BORDER_WRAP};
+const char* const border_names[] = {"constant", "clamp", "mirror", "wrap"};
+const Image::pixel_type gray(0x1234, 0x8000, 0xfedc);
+
+const Scale::Interpolation interpolations[] = {
+	Scale::INTERPOLATION_NEAREST, Scale::INTERPOLATION_BOX, Scale::INTERPOLATION_BILINEAR,
+	Scale::INTERPOLATION_BICUBIC, Scale::INTERPOLATION_LANCZOS3};
+const char* const interpolation_names[] = {"nearest", "box", "bilinear", "bicubic", "lanczos3"};
+
+const Warp::Matrix identity = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+const Warp::Matrix translation = {{1.0, 0.0, 3.0}, {0.0, 1.0, 2.0}, {0.0, 0.0, 1.0}};
+
+Image noisy(column_t width, row_t height, unsigned int seed)
+{
+	Image image(width, height);
+	return noise(image, seed);
+}
+
+/**
+ * (3, 2) だけ右下にずらし、空いたところを gray で埋める。
+ */
+Image shift(const Image& image)
+{
+	Image result(image.width(), image.height());
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			result[h][w] = w < 3 || h < 2 ? gray : image[h - 2][w - 3];
+		}
+	}
+	return result;
+}
+
+int check_filter(const Image& image, const Image& narrow)
+{
+	int failures = 0;
+	failures += check("sobel",     image,      kernel(sobel,     3));
+	failures += check("laplacian", image >> 4, kernel(laplacian, 5));
+	failures += check("smoothing", image,      kernel(smoothing, 5, 1/13.0));
+	failures += check("gaussian",  image,      kernel(gaussian,  3, 1/16.0));
+	failures += check("irrational", image,     kernel(gaussian,  3, 1/std::sqrt(300.0)));
+	failures += check("narrow", narrow, kernel(smoothing, 5, 1/13.0));
+	failures += check("narrow sobel", narrow, kernel(sobel, 3));
+	for(std::size_t i = 0; i < sizeof(borders)/sizeof(borders[0]); ++i){
+		const std::string name = border_names[i];
+		failures += check(name + " sobel",      image,  kernel(sobel, 3),                         borders[i], gray);
+		failures += check(name + " smoothing",  image,  kernel(smoothing, 5, 1/13.0),             borders[i], gray);
+		failures += check(name + " irrational", image,  kernel(smoothing, 5, 1/std::sqrt(170.0)), borders[i], gray);
+		failures += check(name + " narrow",     narrow, kernel(smoothing, 5, 1/13.0),             borders[i], gray);
+	}
+	Image flat(40, 30), zero(40, 30);
+	flat >>= Luster(gray);
+	zero >>= Luster(black);
+	failures += expect_equal("flat smoothing", flat >> WeightedSmoothing(Filter::BORDER_CLAMP), flat);
+	failures += expect_equal("flat sobel", flat >> Sobel(Filter::BORDER_MIRROR), zero);
+	return failures;
+}
+
+int check_separable_filter(const Image& image, const Image& narrow)
+{
+	int failures = 0;
+	if(!Filter(kernel(sobel, 3)).separable() || !Filter(kernel(gaussian, 3, 1/std::sqrt(300.0))).separable() ||
+			Filter(kernel(smoothing, 5, 1/13.0)).separable() || Filter(kernel(laplacian, 5)).separable()){
+		std::cerr << "separable kernel detection failed." << std::endl;
+		++failures;
+	}
+	const double binomial[] = {1/16.0, 4/16.0, 6/16.0, 4/16.0, 1/16.0};
+	const double derivative[] = {-0.5, 0.0, 0.5};
+	const double irrational[] = {0.1, std::sqrt(0.2), 0.3, std::sqrt(0.05), 0.1};
+	const Filter::KernelRow taps5(binomial, binomial + 5), taps3(derivative, derivative + 3), odd(irrational, irrational + 5);
+	failures += check_separable("separable binomial",   image, taps5, taps3);
+	failures += check_separable("separable irrational", image, taps3, odd);
+	failures += check_separable("narrow separable",     narrow, taps5, taps5);
+	failures += check_tiled("large separable", image, SeparableFilter(taps5, odd, Filter::BORDER_WRAP));
+	for(std::size_t i = 0; i < sizeof(borders)/sizeof(borders[0]); ++i){
+		const std::string name = border_names[i];
+		failures += check_separable(name + " separable",        image,  taps3, odd,   borders[i], gray);
+		failures += check_separable(name + " narrow separable", narrow, taps5, taps5, borders[i], gray);
+	}
+	return failures;
+}
+
+/**
+ * 分離できない大きなカーネルは FFT で畳み込む。整数の重みなら直接の畳み込みと一致する。
+ * 参照実装はカーネルの大きさだけ重いので、小さな画像で比べる。
+ */
+int check_fft_filter(const Image& narrow)
+{
+	Filter::Kernel disk(17, Filter::KernelRow(17)), blur(23, Filter::KernelRow(19));
+	for(int i = 0; i < 17; ++i){
+		for(int j = 0; j < 17; ++j){
+			disk[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] = ((i - 8)*(i - 8) + (j - 8)*(j - 8) <= 64 ? 1.0 : 0.0)/197.0;
+		}
+	}
+	for(int i = 0; i < 23; ++i){
+		for(int j = 0; j < 19; ++j){
+			blur[static_cast<std::size_t>(i)][static_cast<std::size_t>(j)] = std::exp(-std::sqrt(static_cast<double>((i - 11)*(i - 11) + (j - 9)*(j - 9)))/3.0)/54.0 - (i == 11 && j == 9 ? 0.25 : 0.0);
+		}
+	}
+	const Image image = noisy(32, 20, 6u);
+	int failures = 0;
+	failures += check("fft disk",        image,  disk);
+	failures += check("narrow fft disk", narrow, disk);
+	failures += check_near("fft blur",   image,  blur);
+	for(std::size_t i = 0; i < sizeof(borders)/sizeof(borders[0]); ++i){
+		const std::string name = border_names[i];
+		failures += check(name + " fft disk",        image,  disk, borders[i], gray);
+		failures += check(name + " narrow fft disk", narrow, disk, borders[i], gray);
+		failures += check_near(name + " fft blur",   image,  blur, borders[i], gray);
+	}
+	failures += check_tiled("large fft disk", image, Filter(disk, Filter::BORDER_WRAP));
+	return failures;
+}
+
+int check_tone(const Image& large)
+{
+	int failures = 0;
+	failures += check_tone_failure("small tone failure", 67, 41, false);
+	failures += check_tone_failure("large tone failure", large.width(), large.height(), false);
+	return failures;
+}
+
+int check_region_tone(const Image& large)
+{
+	Image zones = noisy(200, 150, 3u);
+	Region region(zones.width(), zones.height());
+	std::vector<bool> covered(zones.width()*zones.height(), false);
+	for(row_t y = 0; y < 10; ++y){
+		for(column_t x = 0; x < 10; ++x){
+			const Area area(12, 9, x*20 + 3, y*15 + 2);
+			region.add(area);
+			for(row_t h = area.offset_y_; h < area.offset_y_ + area.height_; ++h){
+				for(column_t w = area.offset_x_; w < area.offset_x_ + area.width_; ++w){
+					covered[h*zones.width() + w] = true;
+				}
+			}
+		}
+	}
+	std::vector<bool> mask(covered.size(), false);
+	for(row_t h = 0; h < zones.height(); ++h){
+		for(column_t w = 0; w < zones.width(); ++w){
+			mask[h*zones.width() + w] = (w - h + 400u)%37u < 11u;
+		}
+	}
+	region.add(Area(60, 40, 10, 5)).add(mask);
+	Image expected = zones;
+	const Offset offset(0x1111);
+	for(row_t h = 0; h < zones.height(); ++h){
+		for(column_t w = 0; w < zones.width(); ++w){
+			const std::size_t i = h*zones.width() + w;
+			if(covered[i] || mask[i] || (10 <= w && w < 70 && 5 <= h && h < 45)){
+				offset.convert(expected[h][w]);
+			}
+		}
+	}
+	int failures = 0;
+	failures += expect_equal("region tone", zones >>= RegionTone(offset, region), expected);
+	failures += check_tone_failure("small region tone failure", 67, 41, true);
+	failures += check_tone_failure("large region tone failure", large.width(), large.height(), true);
+	return failures;
+}
+
+/**
+ * 半径 2 までは比較器の網、それより大きいと度数分布で求める。窓が画像より大きい場合も含める。
+ */
+int check_median()
+{
+	Image speckle = noisy(24, 16, 4u);
+	for(row_t h = 0; h < speckle.height(); ++h){
+		for(column_t w = 0; w < speckle.width(); ++w){
+			if((h*7 + w*3)%5 != 0){
+				const value_type v = static_cast<value_type>(0x4000 + (h + w)*16);
+				speckle[h][w] = Image::pixel_type(v, static_cast<value_type>(v/2), static_cast<value_type>(speckle[h][w].B()/64));
+			}
+		}
+	}
+	const unsigned int radii[] = {1, 2, 3, 7, 12};
+	const Area whole(speckle.width(), speckle.height());
+	const Area part(14, 8, 5, 4);
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(radii)/sizeof(radii[0]); ++i){
+		std::ostringstream name;
+		name << "median radius " << radii[i];
+		failures += expect_equal(name.str(), speckle >> Median(radii[i]), median(speckle, radii[i], whole));
+		failures += expect_equal(name.str() + " in area", speckle >> Median(radii[i], part), median(speckle, radii[i], part));
+	}
+	failures += expect_equal("median default", speckle >> Median(), median(speckle, 1, whole));
+	return failures;
+}
+
+int check_gaussian_blur(const Image& image, const Image& large)
+{
+	int failures = 0;
+	for(double sigma = 0.8; sigma < 20.0; sigma *= 4.0){
+		Image block(201, 201);
+		block >>= Luster(black);
+		for(row_t h = 90; h <= 110; ++h){
+			for(column_t w = 90; w <= 110; ++w){
+				block[h][w] = white;
+			}
+		}
+		block >>= GaussianBlur(sigma);
+		double mass = 0.0, moment = 0.0;
+		for(row_t h = 0; h < block.height(); ++h){
+			for(column_t w = 0; w < block.width(); ++w){
+				mass += block[h][w].G();
+				moment += block[h][w].G()*(static_cast<double>(h) - 100.0)*(static_cast<double>(h) - 100.0);
+			}
+		}
+		const double variance = moment/mass - (21.0*21.0 - 1.0)/12.0;
+		if(1.0e-3 < std::fabs(mass/(21.0*21.0*Image::pixel_type::max) - 1.0) || 0.01 < std::fabs(variance/(sigma*sigma) - 1.0)){
+			std::cerr << "gaussian blur " << sigma << ": mass " << mass/(21.0*21.0*Image::pixel_type::max) << ", variance " << variance << "." << std::endl;
+			++failures;
+		}
+		if(sigma < 2.0){
+			continue;
+		}
+		// 小さな sigma では 3 次の再帰フィルタとガウス関数の形の違いが目立つので、形は sigma 2 以上で比べる。
+		const Filter::KernelRow taps = gaussian_taps(sigma);
+		const Image blurred = image >> 2 >> GaussianBlur(sigma), reference = image >> 2 >> SeparableFilter(taps, taps, Filter::BORDER_CLAMP);
+		if(Image::pixel_type::max/200 < max_difference(blurred, reference)){
+			std::cerr << "gaussian blur " << sigma << ": differs " << max_difference(blurred, reference) << " from separable filter." << std::endl;
+			++failures;
+		}
+	}
+	const column_t widths[] = {97, 1, 2, 5, large.width()};
+	const row_t heights[] = {61, 5, 1, 2, large.height()};
+	for(std::size_t i = 0; i < sizeof(widths)/sizeof(widths[0]); ++i){
+		Image flat_color(widths[i], heights[i]);
+		flat_color >>= Luster(gray);
+		if(!equal(flat_color >> GaussianBlur(0.5), flat_color) || !equal(flat_color >> GaussianBlur(30.0), flat_color)){
+			std::cerr << "gaussian blur " << widths[i] << "x" << heights[i] << ": flat image is not preserved." << std::endl;
+			++failures;
+		}
+	}
+	try{
+		GaussianBlur(0.3);
+		std::cerr << "gaussian blur: sigma 0.3 is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+/**
+ * 窓が画像より広い場合と高い場合は、小さな画像で確かめる。
+ */
+int check_box_blur(const Image& image, const Image& narrow)
+{
+	const column_t box_widths[] = {1, 3, 11, 45, 5};
+	const row_t box_heights[] = {1, 5, 1, 7, 13};
+	const Image tiny = noisy(20, 10, 8u);
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(box_widths)/sizeof(box_widths[0]); ++i){
+		const Filter::Kernel box(box_heights[i], Filter::KernelRow(box_widths[i], 1.0/(static_cast<double>(box_widths[i])*box_heights[i])));
+		const Image& source = box_widths[i] < tiny.width() && box_heights[i] < tiny.height() ? image : tiny;
+		for(std::size_t j = 0; j < sizeof(borders)/sizeof(borders[0]); ++j){
+			if(!equal(source >> BoxBlur(box_widths[i], box_heights[i], borders[j], gray), convolve(source, box, borders[j], gray)) ||
+					!equal(narrow >> BoxBlur(box_widths[i], box_heights[i], borders[j], gray), convolve(narrow, box, borders[j], gray))){
+				std::cerr << "box blur " << box_widths[i] << "x" << box_heights[i] << " " << border_names[j] << ": result unmatch." << std::endl;
+				++failures;
+			}
+		}
+	}
+	failures += check_tiled("large box blur", image, BoxBlur(31, 17, Filter::BORDER_WRAP));
+	try{
+		BoxBlur(4, 3);
+		std::cerr << "box blur: even window is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+int check_scale(const Image& image, const Image& single)
+{
+	const column_t scaled_widths[] = {67, 23, 150, 1, 5};
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(interpolations)/sizeof(interpolations[0]); ++i){
+		for(std::size_t j = 0; j < sizeof(scaled_widths)/sizeof(scaled_widths[0]); ++j){
+			const column_t scaled = scaled_widths[j];
+			Image flat_color(image.width(), image.height());
+			flat_color >>= Luster(gray);
+			Image scaled_color(scaled, image.height());
+			scaled_color >>= Luster(gray);
+			const Image hscaled = image >> HScale(scaled, interpolations[i]);
+			if(!equal(flat_color >> HScale(scaled, interpolations[i]), scaled_color) ||
+					!equal(transpose(flat_color) >> VScale(scaled, interpolations[i]), transpose(scaled_color))){
+				std::cerr << "scale " << interpolation_names[i] << " " << scaled << ": flat image is not preserved." << std::endl;
+				++failures;
+			}
+			if(!equal(transpose(image) >> VScale(scaled, interpolations[i]), transpose(hscaled))){
+				std::cerr << "scale " << interpolation_names[i] << " " << scaled << ": vertical and horizontal unmatch." << std::endl;
+				++failures;
+			}
+			if(scaled == image.width() && !equal(hscaled, image)){
+				std::cerr << "scale " << interpolation_names[i] << ": same size is not identity." << std::endl;
+				++failures;
+			}
+			const Image spread = single >> HScale(scaled, interpolations[i]);
+			for(row_t h = 0; h < spread.height(); ++h){
+				for(column_t w = 0; w < spread.width(); ++w){
+					if(!same(spread[h][w], single[h][0])){
+						std::cerr << "scale " << interpolation_names[i] << " " << scaled << ": single column is not spread." << std::endl;
+						++failures;
+						h = spread.height() - 1;
+						break;
+					}
+				}
+			}
+		}
+	}
+	const Image nearest = image >> HScale(150, Scale::INTERPOLATION_NEAREST);
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < nearest.width(); ++w){
+			if(!same(nearest[h][w], image[h][w*image.width()/nearest.width()])){
+				std::cerr << "scale nearest: result unmatch." << std::endl;
+				++failures;
+				break;
+			}
+		}
+	}
+	Image pairs = Image(66, image.height());
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < pairs.width(); ++w){
+			pairs[h][w] = image[h][w];
+		}
+	}
+	const Image averaged = pairs >> HScale(33, Scale::INTERPOLATION_BOX);
+	for(row_t h = 0; h < averaged.height(); ++h){
+		for(column_t w = 0; w < averaged.width(); ++w){
+			if(averaged[h][w].R() != (pairs[h][w*2].R() + pairs[h][w*2 + 1].R() + 1)/2){
+				std::cerr << "scale box: 2:1 is not an average of pairs." << std::endl;
+				++failures;
+				h = averaged.height() - 1;
+				break;
+			}
+		}
+	}
+	// 1 画素おきの縞を約 1/3 に縮小すると、補間なしでは縞が残り、広げたカーネルでは中間の灰色になる(両端は端の黒を延ばすので除く)。
+	Image stripes(97, 3);
+	for(row_t h = 0; h < stripes.height(); ++h){
+		for(column_t w = 0; w < stripes.width(); ++w){
+			stripes[h][w] = w % 2 ? white : black;
+		}
+	}
+	for(std::size_t i = 3; i < sizeof(interpolations)/sizeof(interpolations[0]); ++i){
+		const Image reduced = stripes >> HScale(31, interpolations[i]);
+		for(column_t w = 1; w + 1 < reduced.width(); ++w){
+			if(Image::pixel_type::max/16 < std::abs(reduced[1][w].G() - Image::pixel_type::max/2)){
+				std::cerr << "scale " << interpolation_names[i] << ": stripes alias to " << reduced[1][w].G() << "." << std::endl;
+				++failures;
+				break;
+			}
+		}
+	}
+	try{
+		image >> HScale(0);
+		std::cerr << "scale: width 0 is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+int check_resize(const Image& image, const Image& large)
+{
+	const column_t resized_widths[] = {67, 23, 150, 1};
+	const row_t resized_heights[] = {41, 300, 13, 1};
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(interpolations)/sizeof(interpolations[0]); ++i){
+		for(std::size_t j = 0; j < sizeof(resized_widths)/sizeof(resized_widths[0]); ++j){
+			const Resize resize(resized_widths[j], resized_heights[j], interpolations[i]);
+			const Image separated = image >> HScale(resized_widths[j], interpolations[i]) >> VScale(resized_heights[j], interpolations[i]);
+			Image streamed(resized_widths[j], resized_heights[j]);
+			Collector collector(streamed);
+			resize.stream(image, collector);
+			if(!equal(image >> resize, separated) || !equal(streamed, separated) || collector.next() != resized_heights[j]){
+				std::cerr << "resize " << interpolation_names[i] << " " << resized_widths[j] << "x" << resized_heights[j] << ": result unmatch." << std::endl;
+				++failures;
+			}
+		}
+	}
+	failures += expect_equal("large resize", large >> Resize(211, 331, Scale::INTERPOLATION_LANCZOS3),
+			large >> HScale(211, Scale::INTERPOLATION_LANCZOS3) >> VScale(331, Scale::INTERPOLATION_LANCZOS3));
+	return failures;
+}
+
+int check_warp(const Image& image)
+{
+	const Image shifted = shift(image);
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(interpolations)/sizeof(interpolations[0]); ++i){
+		if(interpolations[i] == Scale::INTERPOLATION_BOX || interpolations[i] == Scale::INTERPOLATION_LANCZOS3){
+			try{
+				Warp(identity, interpolations[i]);
+				std::cerr << "warp " << interpolation_names[i] << ": interpolation is accepted." << std::endl;
+				++failures;
+			}catch(const std::invalid_argument&){
+			}
+			continue;
+		}
+		if(!equal(image >> Warp(identity, interpolations[i]), image) || !equal(image >> Warp(translation, interpolations[i], gray), shifted)){
+			std::cerr << "warp " << interpolation_names[i] << ": translation unmatch." << std::endl;
+			++failures;
+		}
+	}
+	const double corners[4][2] = {{0.0, 0.0}, {67.0, 0.0}, {0.0, 41.0}, {67.0, 41.0}};
+	const double projected[4][2] = {{5.5, 3.0}, {60.0, -2.0}, {-4.0, 44.0}, {70.0, 33.5}};
+	Warp::Matrix perspective, inverse;
+	Warp::homography(corners, projected, perspective);
+	for(int i = 0; i < 4; ++i){
+		const double z = perspective[2][0]*corners[i][0] + perspective[2][1]*corners[i][1] + perspective[2][2];
+		const double x = (perspective[0][0]*corners[i][0] + perspective[0][1]*corners[i][1] + perspective[0][2])/z;
+		const double y = (perspective[1][0]*corners[i][0] + perspective[1][1]*corners[i][1] + perspective[1][2])/z;
+		if(1.0e-9 < std::fabs(x - projected[i][0]) || 1.0e-9 < std::fabs(y - projected[i][1])){
+			std::cerr << "homography: corner " << i << " is mapped to (" << x << ", " << y << ")." << std::endl;
+			++failures;
+		}
+	}
+	Warp::homography(projected, corners, inverse);
+	if(1 < max_difference(image >> Warp(perspective, Scale::INTERPOLATION_BILINEAR, gray), warp(image, inverse, gray))){
+		std::cerr << "warp perspective: result unmatch." << std::endl;
+		++failures;
+	}
+	Image corrected(image.width(), image.height());
+	corrected >>= Luster(white);
+	corrected >>= KeyStone(KeyStone::TOP_LEFT, 10, 8);
+	if(corrected[2][2].G() || corrected[2][64].G() != Image::pixel_type::max ||
+			corrected[38][5].G() != Image::pixel_type::max || corrected[20][33].G() != Image::pixel_type::max){
+		std::cerr << "key stone: corners unmatch." << std::endl;
+		++failures;
+	}
+	try{
+		const double collinear[4][2] = {{0.0, 0.0}, {1.0, 1.0}, {2.0, 2.0}, {3.0, 3.0}};
+		Warp::Matrix m;
+		Warp::homography(collinear, corners, m);
+		std::cerr << "homography: collinear points are accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+int check_remap_table(const Image& image, const Image& narrow)
+{
+	const RemapTable::Projective unmoved(identity), moved(translation);
+	std::vector<double> grid;
+	for(int j = 0; j < 3; ++j){
+		for(int i = 0; i < 4; ++i){
+			grid.push_back(image.width()*static_cast<double>(i)/3.0);
+			grid.push_back(image.height()*static_cast<double>(j)/2.0);
+		}
+	}
+	const RemapTable::Radial undistorted(33.5, 20.5, 39.0, 0.0);
+	const RemapTable::Mesh mesh(image.width(), image.height(), 4, 3, grid);
+	int failures = 0;
+	failures += expect_equal("remap table projective identity", image >> RemapTable(image.width(), image.height(), unmoved), image);
+	failures += expect_equal("remap table radial identity", image >> RemapTable(image.width(), image.height(), undistorted), image);
+	failures += expect_equal("remap table mesh identity", image >> RemapTable(image.width(), image.height(), mesh), image);
+	const RemapTable table(image.width(), image.height(), moved, gray);
+	failures += expect_equal("remap table translation", image >> table, shift(image));
+	// 1 次式の濃淡を端数だけずらしても 1 次式のままになる。
+	Image ramp(64, 32);
+	for(row_t h = 0; h < ramp.height(); ++h){
+		for(column_t w = 0; w < ramp.width(); ++w){
+			ramp[h][w] = Image::pixel_type(static_cast<uint16_t>(w*1000), static_cast<uint16_t>(h*2000), static_cast<uint16_t>(w*500 + h*1000));
+		}
+	}
+	const Warp::Matrix subpixel = {{1.0, 0.0, -0.25}, {0.0, 1.0, -0.75}, {0.0, 0.0, 1.0}};
+	const Image ramped = ramp >> RemapTable(ramp.width(), ramp.height(), RemapTable::Projective(subpixel));
+	for(row_t h = 0; h + 1 < ramp.height(); ++h){
+		for(column_t w = 0; w + 1 < ramp.width(); ++w){
+			if(1 < std::abs(ramped[h][w].R() - static_cast<int>(w*1000 + 250)) || 1 < std::abs(ramped[h][w].G() - static_cast<int>(h*2000 + 1500)) ||
+					1 < std::abs(ramped[h][w].B() - static_cast<int>(w*500 + h*1000 + 875))){
+				std::cerr << "remap table: subpixel shift unmatch at " << w << ", " << h << "." << std::endl;
+				++failures;
+				h = ramp.height();
+				break;
+			}
+		}
+	}
+	const std::string remap_file = "ImageProcesses.remap";
+	const RemapTable distortion(image.width(), image.height(), RemapTable::Radial(33.5, 20.5, 39.0, 0.2, -0.05), gray);
+	distortion.write(remap_file);
+	const RemapTable loaded(remap_file);
+	// 見出しは "RMAP"、幅と高さが 4 バイトずつ、背景色が 6 バイト。その後に 8 バイトの Entry が並ぶ。
+	const std::size_t entries = 18;
+	failures += check_corrupt("remap table offset overflow", remap_file, entries, std::string("\xf0\xff\xff\xff", 4));
+	failures += check_corrupt("remap table last column", remap_file, entries, std::string("\x42\x00\x00\x00", 4));
+	failures += check_corrupt("remap table last row", remap_file, entries, std::string("\x78\x0a\x00\x00", 4));
+	failures += check_corrupt("remap table fraction", remap_file, entries, std::string("\x00\x00\x00\x00\x01\x01\x00\x00", 8));
+	failures += check_corrupt("remap table size overflow", remap_file, 4, std::string("\xff\xff\xff\xff\xff\xff\xff\xff", 8));
+	failures += check_corrupt("remap table truncated", remap_file, entries + 8, "");
+	std::remove(remap_file.c_str());
+	if(!equal(image >> loaded, image >> distortion) || loaded.width() != image.width() || loaded.height() != image.height()){
+		std::cerr << "remap table: loaded table unmatch." << std::endl;
+		++failures;
+	}
+	try{
+		narrow >> table;
+		std::cerr << "remap table: size unmatch is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	try{
+		RemapTable("ImageProcesses.missing");
+		std::cerr << "remap table: missing file is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+int check_orientation(const Image& image, const Image& narrow, const Image& single, const Image& large)
+{
+	const Image square = noisy(256, 256, 10u);
+	const Image* const oriented[] = {&image, &square, &narrow, &single, &large};
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(oriented)/sizeof(oriented[0]); ++i){
+		const Image& source = *oriented[i];
+		// 時計回りに 90 度回して左右を反転すると、行と列を入れ替えたのと同じになる。
+		if(!equal(source >> Transpose(), orient(source, 1, true)) || !equal(source >> Rotate90(), orient(source, 1, false)) ||
+				!equal(source >> Rotate180(), orient(source, 2, false)) || !equal(source >> Rotate270(), orient(source, 3, false)) ||
+				!equal(source >> FlipH(), orient(source, 0, true)) || !equal(source >> FlipV(), orient(source, 2, true))){
+			std::cerr << "orientation " << source.width() << "x" << source.height() << ": result unmatch." << std::endl;
+			++failures;
+		}
+		if(!equal(source >> Rotate90() >> Rotate90() >> Rotate90() >> Rotate90(), source) || !equal(source >> Transpose() >> Transpose(), source)){
+			std::cerr << "orientation " << source.width() << "x" << source.height() << ": round trip unmatch." << std::endl;
+			++failures;
+		}
+	}
+	return failures;
+}
+
+/**
+ * 参照実装は窓の全ての画素を見るので、画像より大きな要素も含めて小さな画像で比べる。
+ */
+int check_morphology(const Image& narrow, const Image& single, const Image& large)
+{
+	const Image patch = noisy(31, 19, 11u);
+	const column_t element_widths[] = {1, 3, 4, 15, 1, 100, 2};
+	const row_t element_heights[] = {1, 5, 2, 1, 9, 3, 60};
+	int failures = 0;
+	for(std::size_t i = 0; i < sizeof(element_widths)/sizeof(element_widths[0]); ++i){
+		const column_t ew = element_widths[i];
+		const row_t eh = element_heights[i];
+		const Image* const sources[] = {&patch, &narrow, &single};
+		for(std::size_t j = 0; j < sizeof(sources)/sizeof(sources[0]); ++j){
+			const Image& source = *sources[j];
+			const Image eroded = erode(source, ew, eh), dilated = dilate(source, ew, eh);
+			const Image opened = dilate(eroded, ew, eh);
+			if(!equal(source >> Erode(ew, eh), eroded) || !equal(source >> Dilate(ew, eh), dilated) ||
+					!equal(source >> Open(ew, eh), opened) || !equal(source >> Close(ew, eh), erode(dilated, ew, eh)) ||
+					!equal(opened >> Open(ew, eh), opened)){
+				std::cerr << "morphology " << ew << "x" << eh << " on " << source.width() << "x" << source.height() << ": result unmatch." << std::endl;
+				++failures;
+			}
+			const Image hat = source >> TopHat(ew, eh);
+			for(row_t h = 0; h < source.height(); ++h){
+				for(column_t w = 0; w < source.width(); ++w){
+					if(hat[h][w].G() != source[h][w].G() - opened[h][w].G()){
+						std::cerr << "top hat " << ew << "x" << eh << ": result unmatch." << std::endl;
+						++failures;
+						h = source.height() - 1;
+						break;
+					}
+				}
+			}
+		}
+	}
+	failures += expect_equal("large erode", large >> Erode(7, 3), erode(large, 7, 3));
+	try{
+		Erode(0, 3);
+		std::cerr << "erode: empty element is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+int check_gradient(const Image& image, const Image& narrow, const Image& single)
+{
+	int failures = 0;
+	for(std::size_t j = 0; j < sizeof(borders)/sizeof(borders[0]); ++j){
+		failures += check_operator("sobel gradient " + std::string(border_names[j]), image, Gradient::OPERATOR_SOBEL, borders[j]);
+		failures += check_operator("prewitt gradient " + std::string(border_names[j]), narrow, Gradient::OPERATOR_PREWITT, borders[j]);
+	}
+	failures += check_tiled("large gradient", image, Gradient(Gradient::OPERATOR_SOBEL, Gradient::NORM_L2, 0, Filter::BORDER_WRAP));
+	failures += check_operator("single gradient", single, Gradient::OPERATOR_SOBEL, Filter::BORDER_MIRROR);
+	return failures;
+}
+
+int check_bilateral()
+{
+	int failures = 0;
+	Image uniform(67, 41);
+	uniform >>= Luster(gray);
+	failures += expect_equal("flat bilateral", uniform >> Bilateral(4.0, 1024.0), uniform);
+	Image step(64, 48), noisy_image(128, 96);
+	for(row_t h = 0; h < step.height(); ++h){
+		for(column_t w = 0; w < step.width(); ++w){
+			step[h][w] = w < step.width()/2 ? Image::pixel_type(0x2000, 0x3000, 0x1000) : Image::pixel_type(0xe000, 0xd000, 0xf000);
+		}
+	}
+	const int step_difference = max_difference(step >> Bilateral(4.0, 2048.0), step);
+	if(1 < step_difference){
+		std::cerr << "step bilateral: edge is blurred by " << step_difference << "." << std::endl;
+		++failures;
+	}
+	noise(noisy_image, 1u, 0x7c00, 0x800);
+	const value_type* const values = reinterpret_cast<const value_type*>(&noisy_image[0][0]);
+	const std::size_t count = noisy_image.width()*noisy_image.height()*3u;
+	const Image smoothed = noisy_image >> Bilateral(4.0, 16384.0);
+	const value_type* const smooth = reinterpret_cast<const value_type*>(&smoothed[0][0]);
+	double before = 0.0, after = 0.0;
+	for(std::size_t i = 0; i < count; ++i){
+		const double n = values[i] - 0x8000, m = smooth[i] - 0x8000;
+		before += n*n;
+		after += m*m;
+	}
+	if(before/16.0 < after){
+		std::cerr << "noisy bilateral: noise is not reduced (" << before/static_cast<double>(count) << " -> " << after/static_cast<double>(count) << ")." << std::endl;
+		++failures;
+	}
+	try{
+		Bilateral(0.5, 1024.0);
+		std::cerr << "bilateral: sigma 0.5 is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
+
+}
+
+int main(void)
+{
+	// 参照実装は素朴に全ての画素を計算するので、Debug ビルドでも数秒で終わる小さな画像と比べる。
+	// large は tone_parallel_pixels(0x10000 画素)を超え、並列の経路を通る。
+	const Image image = noisy(67, 41, 1u), narrow = noisy(3, 9, 7u), single = noisy(1, 41, 9u), large = noisy(300, 220, 5u);
+
+	int failures = 0;
+	failures += check_filter(image, narrow);
+	failures += check_separable_filter(image, narrow);
+	failures += check_fft_filter(narrow);
+	failures += check_tone(large);
+	failures += check_region_tone(large);
+	failures += check_median();
+	failures += check_gaussian_blur(image, large);
+	failures += check_box_blur(image, narrow);
+	failures += check_scale(image, single);
+	failures += check_resize(image, large);
+	failures += check_warp(image);
+	failures += check_remap_table(image, narrow);
+	failures += check_orientation(image, narrow, single, large);
+	failures += check_morphology(narrow, single, large);
+	failures += check_gradient(image, narrow, single);
+	failures += check_bilateral();
+	return failures;
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Image.hpp"
+#include "PixelConverters.hpp"
+#include "TransferFunction.hpp"
+#include "Random.hpp"
+
+namespace{
+
+typedef Image::pixel_type::value_type value_type;
+
+bool equal(const Image& lhs, const Image& rhs)
+{
+	return lhs.width() == rhs.width() && lhs.height() == rhs.height() && std::equal(lhs.head(), lhs.tail(), rhs.head());
+}
+
+/**
+ * convert() だけを上書きした派生クラス。Tone が基底クラスの行ループで済ませていないかを確かめる。
+ */
+class Halve: public Channel{
+public:
+	Halve(Ch c): Channel(c){}
+	virtual ~Halve();
+	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+};
+
+Halve::~Halve(){}
+
+Image::pixel_type& Halve::convert(Image::pixel_type& pixel)const
+{
+	Channel::convert(pixel);
+	return pixel = Image::pixel_type(static_cast<value_type>(pixel.R()/2), static_cast<value_type>(pixel.G()/2), static_cast<value_type>(pixel.B()/2));
+}
+
+class ClampedOffset: public Offset{
+public:
+	ClampedOffset(value_type offset): Offset(offset){}
+	virtual ~ClampedOffset();
+	virtual Image::pixel_type& convert(Image::pixel_type& pixel)const;
+};
+
+ClampedOffset::~ClampedOffset(){}
+
+Image::pixel_type& ClampedOffset::convert(Image::pixel_type& pixel)const
+{
+	Offset::convert(pixel);
+	return pixel = Image::pixel_type(std::min(pixel.R(), value_type(0xc000)), std::min(pixel.G(), value_type(0xc000)), std::min(pixel.B(), value_type(0xc000)));
+}
+
+int check_span(const std::string& name, const PixelConverter& converter, const Image& image)
+{
+	Image expected = image;
+	for(row_t h = 0; h < expected.height(); ++h){
+		for(column_t w = 0; w < expected.width(); ++w){
+			converter.convert(expected[h][w]);
+		}
+	}
+	if(!equal(image >> converter, expected)){
+		std::cerr << name << ": span result unmatch." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+}
+
+int main(void)
+{
+	std::vector<value_type> gamma(Image::pixel_type::max + 1u);
+	for(std::size_t i = 0; i < gamma.size(); ++i){
+		gamma[i] = static_cast<value_type>(std::pow(static_cast<double>(i)/65535.0, 1.0/2.2)*65535.0 + 0.5);
+	}
+	const Offset   offset(0x1234);
+	const Offset   darken(0x2000, true, Channel::G);
+	const Gamma    correct(gamma, Channel::B);
+	const Reversal reverse(Channel::R | Channel::B);
+	const Channel  mask(Channel::R | Channel::G);
+
+	Image image(123, 45);
+	noise(image);
+	const Image expected = image >> offset >> darken >> correct >> reverse >> mask;
+
+	int failures = 0;
+	for(Channel::Ch c = 0; c <= (Channel::R | Channel::G | Channel::B); ++c){
+		failures += check_span("channel",  Channel(c), image);
+		failures += check_span("offset",   Offset(0x4321, false, c), image);
+		failures += check_span("darken",   Offset(0x4321, true, c), image);
+		failures += check_span("reversal", Reversal(c), image);
+		failures += check_span("gamma",    Gamma(gamma, c), image);
+	}
+	failures += check_span("srgb", Gamma(TransferFunction::srgb(), Gamma::ENCODE, Channel::R | Channel::B), image);
+	failures += check_span("grayscale", GrayScale(), image);
+	failures += check_span("threshold", Threshold(0x8000, Channel::G), image);
+	failures += check_span("threshold", Threshold(0x1234, Channel::B), image);
+	failures += check_span("derived channel", Halve(Channel::R | Channel::B), image);
+	failures += check_span("derived offset", ClampedOffset(0x1234), image);
+
+	Image large(640, 480);
+	noise(large, 2u);
+	failures += check_span("large offset", Offset(0x4321, false, Channel::R | Channel::B), large);
+	failures += check_span("large threshold", Threshold(0x8000, Channel::R), large);
+	try{
+		large >>= Threshold(0x8000, Channel::R | Channel::G);
+		std::cerr << "threshold: invalid channel is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+
+	const LookUpTable lut = LookUpTable() >> offset >> darken >> correct >> reverse >> mask;
+	if(!equal(image >> lut, expected)){
+		std::cerr << "chained lookup table: result unmatch." << std::endl;
+		++failures;
+	}
+	LookUpTable nested(offset);
+	nested >>= LookUpTable(darken) >> correct;
+	nested >>= LookUpTable() >> reverse >> mask;
+	if(!equal(image >> nested, expected)){
+		std::cerr << "nested lookup table: result unmatch." << std::endl;
+		++failures;
+	}
+	Image::pixel_type pixel = image[3][4];
+	Image::pixel_type converted = expected[3][4];
+	lut.convert(pixel);
+	if(pixel.R() != converted.R() || pixel.G() != converted.G() || pixel.B() != converted.B()){
+		std::cerr << "lookup table: single pixel result unmatch." << std::endl;
+		++failures;
+	}
+
+	if(&TransferFunction::power(2.2) != &TransferFunction::power(2.2) || &TransferFunction::power(2.2) == &TransferFunction::power(2.6)){
+		std::cerr << "power: transfer function is not shared." << std::endl;
+		++failures;
+	}
+	const Gamma encode(TransferFunction::power(2.2), Gamma::ENCODE);
+	const Gamma copied(correct);
+	for(unsigned int v = 0; v <= Image::pixel_type::max; v += 257u){
+		const value_type code = static_cast<value_type>(v);
+		Image::pixel_type p(code, code, code), q(code, code, code);
+		encode.convert(p);
+		copied.convert(q);
+		if(p.R() != gamma[v] || q.B() != gamma[v]){
+			std::cerr << "shared gamma table: " << v << " -> " << p.R() << ", expected " << gamma[v] << std::endl;
+			++failures;
+		}
+		Image::pixel_type r(code, code, code);
+		Gamma(TransferFunction::srgb(), Gamma::DECODE).convert(Gamma(TransferFunction::srgb(), Gamma::ENCODE).convert(r));
+		if(1 < std::abs(r.G() - static_cast<int>(v))){
+			std::cerr << "srgb: round trip of " << v << " -> " << r.G() << std::endl;
+			++failures;
+		}
+	}
+
+	try{
+		LookUpTable() >> offset >> GrayScale();
+		std::cerr << "lookup table: non separable converter is accepted." << std::endl;
+		++failures;
+	}catch(const std::invalid_argument&){
+	}
+	return failures;
+}
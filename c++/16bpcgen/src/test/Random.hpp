@@ -0,0 +1,31 @@
+#ifndef BPCGEN_TEST_RANDOM_HPP_
+#define BPCGEN_TEST_RANDOM_HPP_
+
+#include "Image.hpp"
+
+/**
+ * テストの入力を作る線形合同法の乱数。seed を進めてその値を返す。下位のビットは周期が短いので、
+ * 呼び出し側は必要なだけ上位のビットを使う。種が同じなら処理系によらず同じ列になる。
+ */
+inline unsigned int next_random(unsigned int& seed)
+{
+	return seed = seed*1103515245u + 12345u;
+}
+
+/**
+ * 画像の全ての値を base + [0, amplitude) の乱数で埋める。既定では 16bit の全域。
+ * ループを含む関数は inline にすると -Winline で止まるので、テンプレートにしてヘッダに置く。
+ */
+template <typename Pixels>
+Pixels& noise(Pixels& image, unsigned int seed = 1u, unsigned int base = 0u, unsigned int amplitude = 0x10000u)
+{
+	typedef typename Pixels::pixel_type::value_type value_type;
+	value_type* const first = reinterpret_cast<value_type*>(&image[0][0]);
+	value_type* const last  = reinterpret_cast<value_type*>(&image[image.height()][0]);
+	for(value_type* p = first; p != last; ++p){
+		*p = static_cast<value_type>(base + (next_random(seed) >> 16)%amplitude);
+	}
+	return image;
+}
+
+#endif
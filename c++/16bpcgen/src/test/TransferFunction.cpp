@@ -0,0 +1,66 @@
+#include <cmath>
+#include <iostream>
+#include <string>
+#include "Image.hpp"
+#include "LinearImage.hpp"
+#include "TransferFunction.hpp"
+#include "Random.hpp"
+
+namespace{
+
+int check(const std::string& name, const TransferFunction& tf)
+{
+	int failures = 0;
+	for(unsigned int i = 0; i <= Pixel<>::max; ++i){
+		const TransferFunction::value_type code = static_cast<TransferFunction::value_type>(i);
+		const double expected = std::floor(tf.from_linear(static_cast<double>(tf.decode(code)))*Pixel<>::max + 0.5);
+		const double actual = tf.encode(tf.decode(code));
+		if(1.0 < std::fabs(actual - expected) || 1.0 < std::fabs(actual - code)){
+			if(!failures++){
+				std::cerr << name << ": encode error too large. code = " << i << ", expected = " << expected << ", actual = " << actual << std::endl;
+			}
+		}
+	}
+	unsigned int seed = 1u;
+	for(int i = 0; i < 100000; ++i){
+		const float linear = std::pow(static_cast<float>(next_random(seed) >> 8)/16777216.0f, 4.0f);
+		const double expected = std::floor(tf.from_linear(static_cast<double>(linear))*Pixel<>::max + 0.5);
+		if(1.0 < std::fabs(tf.encode(linear) - expected)){
+			if(!failures++){
+				std::cerr << name << ": encode error too large. linear = " << linear << ", expected = " << expected << std::endl;
+			}
+		}
+	}
+	return failures ? 1 : 0;
+}
+
+}
+
+int main(void)
+{
+	int failures = 0;
+	failures += check("linear", TransferFunction::linear());
+	failures += check("power",  TransferFunction(TransferFunction::TF_POWER, 2.6));
+	failures += check("sRGB",   TransferFunction::srgb());
+	failures += check("BT.1886", TransferFunction::bt1886());
+	failures += check("PQ",     TransferFunction::pq());
+	failures += check("HLG",    TransferFunction::hlg());
+
+	Image image(64, 32);
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			const Image::pixel_type::value_type v = static_cast<Image::pixel_type::value_type>((h*image.width() + w)*31u);
+			image[h][w] = Image::pixel_type(v, static_cast<Image::pixel_type::value_type>(v/2), static_cast<Image::pixel_type::value_type>(v/3));
+		}
+	}
+	const Image roundtrip = LinearImage(image, TransferFunction::pq()).encode(TransferFunction::pq());
+	for(row_t h = 0; h < image.height(); ++h){
+		for(column_t w = 0; w < image.width(); ++w){
+			if(1 < std::abs(image[h][w].R() - roundtrip[h][w].R()) || 1 < std::abs(image[h][w].B() - roundtrip[h][w].B())){
+				std::cerr << "LinearImage: roundtrip error too large." << std::endl;
+				return 1;
+			}
+		}
+	}
+	return failures;
+}
@@ -40,6 +40,10 @@ int main(void)
 			<< Character(" !\"#$%&'()*+,-./\n"
 						"0123456789:;<=>?@\nABCDEFGHIJKLMNO\nPQRSTUVWXYZ[\\]^_`\n"
 						"abcdefghijklmno\npqrstuvwxyz{|}~", red, 10) >> "./img/character.png";
+	image << ChromaticityDiagram()
+			.gamut(Primaries::bt709())
+			.gamut(Primaries::dci_p3(), yellow)
+			.gamut(Primaries::bt2020(), cyan)  >> "./img/chromaticity_diagram.png";
 #if 201103L <= __cplusplus
 	image << WhiteNoise() >> "./img/whitenoise.png";
 #endif